@@ -0,0 +1,93 @@
+// File: arena.cpp
+// Purpose: Implementation of the arena allocator.
+#include "arena.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// the usual size of a block (big requests get a block of their own)
+static const size_t BLOCK_SIZE = 64 * 1024;
+
+Arena::Arena()
+{
+  _blocks = nullptr;
+  _cur = nullptr;
+  _end = nullptr;
+  _finalizers = nullptr;
+}
+
+Arena::~Arena()
+{
+  // destroy the objects, newest first
+  for (Finalizer *f = _finalizers; f != nullptr; f = f->next)
+  {
+    f->destroy(f->object);
+  }
+
+  // then release all of the memory in one sweep
+  while (_blocks != nullptr)
+  {
+    Block *next = _blocks->next;
+    std::free(_blocks);
+    _blocks = next;
+  }
+}
+
+// allocate uninitialized memory which lives as long as the arena
+void *Arena::allocate(size_t size, size_t align)
+{
+  uintptr_t p = ((uintptr_t)_cur + align - 1) & ~(uintptr_t)(align - 1);
+  if (_cur == nullptr or p + size > (uintptr_t)_end)
+  {
+    grow(size + align);
+    p = ((uintptr_t)_cur + align - 1) & ~(uintptr_t)(align - 1);
+  }
+
+  _cur = (char *)(p + size);
+  return (void *)p;
+}
+
+// run destroy(object) when the arena is torn down
+void Arena::on_destroy(void *object, void (*destroy)(void *))
+{
+  Finalizer *f = (Finalizer *)allocate(sizeof(Finalizer), alignof(Finalizer));
+  f->object = object;
+  f->destroy = destroy;
+  f->next = _finalizers;
+  _finalizers = f;
+}
+
+// return a copy of text owned by the arena, sharing equal strings
+std::string_view Arena::intern(std::string_view text)
+{
+  auto itr = _strings.find(text);
+  if (itr != _strings.end())
+  {
+    return *itr;
+  }
+
+  char *copy = (char *)allocate(text.size() + 1, 1);
+  std::memcpy(copy, text.data(), text.size());
+  copy[text.size()] = '\0';
+
+  std::string_view result(copy, text.size());
+  _strings.insert(result);
+  return result;
+}
+
+// start a new block big enough for size bytes
+void Arena::grow(size_t size)
+{
+  size_t bytes = sizeof(Block) + (size > BLOCK_SIZE ? size : BLOCK_SIZE);
+  Block *block = (Block *)std::malloc(bytes);
+  if (block == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+
+  block->next = _blocks;
+  _blocks = block;
+  _cur = (char *)(block + 1);
+  _end = (char *)block + bytes;
+}
@@ -0,0 +1,55 @@
+// File: arena.h
+// Purpose: A bump allocator which owns a parse tree and its lexemes, and
+//          frees them all at once.
+#ifndef ARENA_H
+#define ARENA_H
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+class Arena
+{
+public:
+  Arena();
+  ~Arena();
+
+  // allocate uninitialized memory which lives as long as the arena
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+  // run destroy(object) when the arena is torn down
+  void on_destroy(void *object, void (*destroy)(void *));
+
+  // return a copy of text owned by the arena, sharing equal strings
+  std::string_view intern(std::string_view text);
+
+private:
+  // memory is handed out from a chain of blocks
+  struct Block
+  {
+    Block *next;
+  };
+
+  // objects which need their destructor run, newest first
+  struct Finalizer
+  {
+    void *object;
+    void (*destroy)(void *);
+    Finalizer *next;
+  };
+
+  Block *_blocks;
+  char *_cur;
+  char *_end;
+  Finalizer *_finalizers;
+  std::unordered_set<std::string_view> _strings;
+
+  // start a new block big enough for size bytes
+  void grow(size_t size);
+
+  // arenas own their memory, so they cannot be copied
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+};
+
+#endif
@@ -0,0 +1,88 @@
+// File: batch_input.cpp
+// Purpose: Implementation of block buffered batch input.
+#include "batch_input.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+// size of each read
+static const size_t block_size = 1 << 16;
+
+Batch_Input *Batch_Input::_active = nullptr;
+
+Batch_Input::Batch_Input() : _buffer(block_size), _start(0), _end(0), _eof(false)
+{
+  _active = this;
+}
+
+Batch_Input::~Batch_Input()
+{
+  _active = nullptr;
+}
+
+// the Batch_Input in use, or nullptr when input is interactive
+Batch_Input *Batch_Input::active()
+{
+  return _active;
+}
+
+// the next line without its newline, false at the end of the input
+bool Batch_Input::next_line(std::string_view &line)
+{
+  size_t searched = _start;
+  for (;;)
+  {
+    const char *begin = _buffer.data() + _start;
+    const char *newline = (const char *)memchr(_buffer.data() + searched, '\n', _end - searched);
+    if (newline)
+    {
+      line = std::string_view(begin, newline - begin);
+      _start = newline + 1 - _buffer.data();
+      return true;
+    }
+
+    // no newline yet, so read more (the unread part moves to the front)
+    searched = _end - _start;
+    if (not fill())
+    {
+      // the last line may not end in a newline
+      line = std::string_view(_buffer.data() + _start, _end - _start);
+      _start = _end;
+      return not line.empty();
+    }
+  }
+}
+
+// read another block, keeping the unread part, false if there is no more
+bool Batch_Input::fill()
+{
+  if (_eof)
+  {
+    return false;
+  }
+
+  // move the unread part to the front, growing the buffer for long lines
+  memmove(_buffer.data(), _buffer.data() + _start, _end - _start);
+  _end -= _start;
+  _start = 0;
+  if (_buffer.size() - _end < block_size)
+  {
+    _buffer.resize(_end + block_size);
+  }
+
+  for (;;)
+  {
+    ssize_t got = ::read(STDIN_FILENO, _buffer.data() + _end, _buffer.size() - _end);
+    if (got < 0 and errno == EINTR)
+    {
+      continue;
+    }
+    if (got <= 0)
+    {
+      _eof = true;
+      return false;
+    }
+    _end += got;
+    return true;
+  }
+}
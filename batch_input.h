@@ -0,0 +1,41 @@
+// File: batch_input.h
+// Purpose: Reading program input from a pipe or file in large blocks,
+//          for batch runs which feed scripts many values.
+#ifndef BATCH_INPUT_H
+#define BATCH_INPUT_H
+#include <string_view>
+#include <vector>
+
+// While a Batch_Input exists, input statements take their values from it
+// instead of prompting and reading std::cin a line at a time. It reads
+// stdin in large blocks and hands out lines as views into its buffer, which
+// stay valid until the next line is read. Only one may exist at a time.
+class Batch_Input
+{
+public:
+  Batch_Input();
+  ~Batch_Input();
+
+  // the Batch_Input in use, or nullptr when input is interactive
+  static Batch_Input *active();
+
+  // the next line without its newline, false at the end of the input
+  bool next_line(std::string_view &line);
+
+private:
+  std::vector<char> _buffer;
+  size_t _start;  // the unread part of the buffer is [_start, _end)
+  size_t _end;
+  bool _eof;
+
+  static Batch_Input *_active;
+
+  // read another block, keeping the unread part, false if there is no more
+  bool fill();
+
+  // the reader owns the rest of stdin, so it cannot be copied
+  Batch_Input(const Batch_Input &) = delete;
+  Batch_Input &operator=(const Batch_Input &) = delete;
+};
+
+#endif
@@ -0,0 +1,574 @@
+// File: bigint.cpp
+// Purpose: Implementation of arbitrary precision integers.
+#include "bigint.h"
+#include <algorithm>
+#include <climits>
+
+typedef std::vector<uint32_t> Limbs;
+
+// products where both sides have at least this many limbs use Karatsuba
+static const size_t karatsuba_threshold = 40;
+
+// numbers with more limbs than this are split in two to print them
+static const size_t decimal_threshold = 30;
+
+//////////////////////////////////////////
+// Magnitudes
+//////////////////////////////////////////
+
+// drop leading zero limbs
+static void trim_limbs(Limbs &a)
+{
+  while (not a.empty() and a.back() == 0)
+  {
+    a.pop_back();
+  }
+}
+
+// -1, 0 or 1 as |a| is less than, equal to or greater than |b|
+static int compare_limbs(const Limbs &a, const Limbs &b)
+{
+  if (a.size() != b.size())
+  {
+    return a.size() < b.size() ? -1 : 1;
+  }
+  for (size_t i = a.size(); i-- > 0;)
+  {
+    if (a[i] != b[i])
+    {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+static Limbs add_limbs(const Limbs &a, const Limbs &b)
+{
+  const Limbs &longer = a.size() >= b.size() ? a : b;
+  const Limbs &shorter = a.size() >= b.size() ? b : a;
+
+  Limbs result(longer.size() + 1);
+  uint64_t carry = 0;
+  for (size_t i = 0; i < longer.size(); i++)
+  {
+    uint64_t t = (uint64_t)longer[i] + (i < shorter.size() ? shorter[i] : 0) + carry;
+    result[i] = (uint32_t)t;
+    carry = t >> 32;
+  }
+  result[longer.size()] = (uint32_t)carry;
+  trim_limbs(result);
+  return result;
+}
+
+// a - b, where |a| >= |b|
+static Limbs subtract_limbs(const Limbs &a, const Limbs &b)
+{
+  Limbs result(a.size());
+  int64_t borrow = 0;
+  for (size_t i = 0; i < a.size(); i++)
+  {
+    int64_t t = (int64_t)a[i] - (i < b.size() ? b[i] : 0) - borrow;
+    borrow = t < 0;
+    result[i] = (uint32_t)(t + (borrow << 32));
+  }
+  trim_limbs(result);
+  return result;
+}
+
+// add x * 2^(32 * shift) into result, which is big enough to hold the sum
+static void add_shifted(Limbs &result, const Limbs &x, size_t shift)
+{
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < x.size(); i++)
+  {
+    uint64_t t = (uint64_t)result[i + shift] + x[i] + carry;
+    result[i + shift] = (uint32_t)t;
+    carry = t >> 32;
+  }
+  for (i += shift; carry != 0; i++)
+  {
+    uint64_t t = (uint64_t)result[i] + carry;
+    result[i] = (uint32_t)t;
+    carry = t >> 32;
+  }
+}
+
+static Limbs multiply_school(const Limbs &a, const Limbs &b)
+{
+  Limbs result(a.size() + b.size());
+  for (size_t i = 0; i < a.size(); i++)
+  {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < b.size(); j++)
+    {
+      uint64_t t = (uint64_t)a[i] * b[j] + result[i + j] + carry;
+      result[i + j] = (uint32_t)t;
+      carry = t >> 32;
+    }
+    result[i + b.size()] = (uint32_t)carry;
+  }
+  trim_limbs(result);
+  return result;
+}
+
+static Limbs multiply_limbs(const Limbs &a, const Limbs &b)
+{
+  if (a.empty() or b.empty())
+  {
+    return Limbs();
+  }
+  if (a.size() < karatsuba_threshold or b.size() < karatsuba_threshold)
+  {
+    return multiply_school(a, b);
+  }
+
+  // split both at half limbs: a = a1 * 2^(32 * half) + a0, and the same for
+  // b, then a * b = z2 * 2^(64 * half) + z1 * 2^(32 * half) + z0 where
+  // z1 = (a0 + a1)(b0 + b1) - z0 - z2, which takes three products, not four
+  size_t half = std::max(a.size(), b.size()) / 2;
+  auto low = [half](const Limbs &x) {
+    Limbs part(x.begin(), x.begin() + std::min(half, x.size()));
+    trim_limbs(part);
+    return part;
+  };
+  auto high = [half](const Limbs &x) {
+    return x.size() > half ? Limbs(x.begin() + half, x.end()) : Limbs();
+  };
+
+  Limbs a0 = low(a), a1 = high(a);
+  Limbs b0 = low(b), b1 = high(b);
+  Limbs z0 = multiply_limbs(a0, b0);
+  Limbs z2 = multiply_limbs(a1, b1);
+  Limbs z1 = multiply_limbs(add_limbs(a0, a1), add_limbs(b0, b1));
+  z1 = subtract_limbs(subtract_limbs(z1, z0), z2);
+
+  Limbs result(a.size() + b.size() + 1);
+  add_shifted(result, z0, 0);
+  add_shifted(result, z1, half);
+  add_shifted(result, z2, 2 * half);
+  trim_limbs(result);
+  return result;
+}
+
+// divide a by d in place, returning the remainder
+static uint32_t divide_small(Limbs &a, uint32_t d)
+{
+  uint64_t remainder = 0;
+  for (size_t i = a.size(); i-- > 0;)
+  {
+    uint64_t t = (remainder << 32) | a[i];
+    a[i] = (uint32_t)(t / d);
+    remainder = t % d;
+  }
+  trim_limbs(a);
+  return (uint32_t)remainder;
+}
+
+// a = a * m + add
+static void multiply_add_small(Limbs &a, uint32_t m, uint32_t add)
+{
+  uint64_t carry = add;
+  for (uint32_t &limb : a)
+  {
+    uint64_t t = (uint64_t)limb * m + carry;
+    limb = (uint32_t)t;
+    carry = t >> 32;
+  }
+  if (carry != 0)
+  {
+    a.push_back((uint32_t)carry);
+  }
+}
+
+// long division of magnitudes (Knuth's algorithm D), v must not be zero
+static void divide_limbs(const Limbs &u, const Limbs &v, Limbs &q, Limbs &r)
+{
+  if (compare_limbs(u, v) < 0)
+  {
+    q.clear();
+    r = u;
+    return;
+  }
+  if (v.size() == 1)
+  {
+    q = u;
+    uint32_t remainder = divide_small(q, v[0]);
+    r.clear();
+    if (remainder != 0)
+    {
+      r.push_back(remainder);
+    }
+    return;
+  }
+
+  // normalize so the divisor's top bit is set, which keeps the estimated
+  // quotient digits within two of the real ones
+  size_t n = v.size(), m = u.size() - n;
+  int s = __builtin_clz(v[n - 1]);
+  Limbs vn(n), un(u.size() + 1);
+  for (size_t i = n - 1; i > 0; i--)
+  {
+    vn[i] = (v[i] << s) | (s ? v[i - 1] >> (32 - s) : 0);
+  }
+  vn[0] = v[0] << s;
+  un[m + n] = s ? u[m + n - 1] >> (32 - s) : 0;
+  for (size_t i = m + n - 1; i > 0; i--)
+  {
+    un[i] = (u[i] << s) | (s ? u[i - 1] >> (32 - s) : 0);
+  }
+  un[0] = u[0] << s;
+
+  const uint64_t base = 1ull << 32;
+  q.assign(m + 1, 0);
+  for (size_t j = m + 1; j-- > 0;)
+  {
+    // estimate the next quotient digit from the top two limbs
+    uint64_t top = ((uint64_t)un[j + n] << 32) | un[j + n - 1];
+    uint64_t qhat = top / vn[n - 1];
+    uint64_t rhat = top % vn[n - 1];
+    while (qhat >= base or qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2]))
+    {
+      qhat--;
+      rhat += vn[n - 1];
+      if (rhat >= base)
+      {
+        break;
+      }
+    }
+
+    // subtract qhat * v from the current window
+    int64_t borrow = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      uint64_t p = qhat * vn[i];
+      int64_t t = (int64_t)un[i + j] - borrow - (int64_t)(p & 0xFFFFFFFF);
+      un[i + j] = (uint32_t)t;
+      borrow = (int64_t)(p >> 32) - (t >> 32);
+    }
+    int64_t t = (int64_t)un[j + n] - borrow;
+    un[j + n] = (uint32_t)t;
+
+    // the estimate was one too big, add v back
+    q[j] = (uint32_t)qhat;
+    if (t < 0)
+    {
+      q[j]--;
+      uint64_t carry = 0;
+      for (size_t i = 0; i < n; i++)
+      {
+        uint64_t sum = (uint64_t)un[i + j] + vn[i] + carry;
+        un[i + j] = (uint32_t)sum;
+        carry = sum >> 32;
+      }
+      un[j + n] += (uint32_t)carry;
+    }
+  }
+  trim_limbs(q);
+
+  // unnormalize the remainder
+  r.assign(n, 0);
+  for (size_t i = 0; i < n; i++)
+  {
+    r[i] = (un[i] >> s) | (s ? un[i + 1] << (32 - s) : 0);
+  }
+  trim_limbs(r);
+}
+
+// append the digits of a < 10 ^ (9 * 2^level) to text, zero padded to
+// exactly that many digits if pad is set; long numbers are split in half
+// by powers[level - 1], which is much faster than dividing all of a by 10^9
+// once for every nine digits
+static void append_decimal(const Limbs &a, const std::vector<Limbs> &powers, size_t level, bool pad, std::string &text)
+{
+  if (level > 0 and a.size() > decimal_threshold)
+  {
+    Limbs q, r;
+    divide_limbs(a, powers[level - 1], q, r);
+    if (pad or not q.empty())
+    {
+      append_decimal(q, powers, level - 1, pad, text);
+      pad = true;
+    }
+    append_decimal(r, powers, level - 1, pad, text);
+    return;
+  }
+
+  // short numbers, nine digits at a time
+  std::vector<uint32_t> chunks;
+  Limbs rest = a;
+  while (not rest.empty())
+  {
+    chunks.push_back(divide_small(rest, 1000000000));
+  }
+  if (pad)
+  {
+    text.append(((size_t)9 << level) - chunks.size() * 9, '0');
+  }
+  else if (chunks.empty())
+  {
+    text += '0';
+  }
+
+  for (size_t i = chunks.size(); i-- > 0;)
+  {
+    char digits[9];
+    uint32_t chunk = chunks[i];
+    for (int k = 8; k >= 0; k--)
+    {
+      digits[k] = '0' + chunk % 10;
+      chunk /= 10;
+    }
+    if (pad or i + 1 < chunks.size())
+    {
+      text.append(digits, 9);
+    }
+    else
+    {
+      text += std::to_string(chunks[i]);
+    }
+  }
+}
+
+//////////////////////////////////////////
+// Big_Int
+//////////////////////////////////////////
+Big_Int::Big_Int() : _negative(false) {}
+
+Big_Int::Big_Int(long long value)
+{
+  _negative = value < 0;
+  unsigned long long magnitude = _negative ? 0ull - (unsigned long long)value : value;
+  _limbs.push_back((uint32_t)magnitude);
+  _limbs.push_back((uint32_t)(magnitude >> 32));
+  trim();
+}
+
+// parse an optionally signed string of decimal digits, false if invalid
+bool Big_Int::parse(std::string_view text, Big_Int &result)
+{
+  bool negative = false;
+  if (not text.empty() and (text[0] == '-' or text[0] == '+'))
+  {
+    negative = text[0] == '-';
+    text.remove_prefix(1);
+  }
+  if (text.empty())
+  {
+    return false;
+  }
+
+  // nine digits at a time
+  result = Big_Int();
+  for (size_t i = 0; i < text.size();)
+  {
+    size_t count = std::min((size_t)9, text.size() - i);
+    uint32_t chunk = 0, scale = 1;
+    for (size_t k = 0; k < count; k++, i++)
+    {
+      if (text[i] < '0' or text[i] > '9')
+      {
+        return false;
+      }
+      chunk = chunk * 10 + (text[i] - '0');
+      scale *= 10;
+    }
+    multiply_add_small(result._limbs, scale, chunk);
+  }
+  result._negative = negative;
+  result.trim();
+  return true;
+}
+
+// true if the value fits in a long long
+bool Big_Int::fits() const
+{
+  if (_limbs.size() > 2)
+  {
+    return false;
+  }
+  unsigned long long magnitude = 0;
+  for (size_t i = _limbs.size(); i-- > 0;)
+  {
+    magnitude = (magnitude << 32) | _limbs[i];
+  }
+  return magnitude <= (unsigned long long)LLONG_MAX + (_negative ? 1 : 0);
+}
+
+// the value as a long long (saturating)
+long long Big_Int::to_integer() const
+{
+  if (not fits())
+  {
+    return _negative ? LLONG_MIN : LLONG_MAX;
+  }
+  unsigned long long magnitude = 0;
+  for (size_t i = _limbs.size(); i-- > 0;)
+  {
+    magnitude = (magnitude << 32) | _limbs[i];
+  }
+  return _negative ? (long long)(0ull - magnitude) : (long long)magnitude;
+}
+
+// the value as the nearest double
+double Big_Int::to_real() const
+{
+  double x = 0;
+  for (size_t i = _limbs.size(); i-- > 0;)
+  {
+    x = x * 4294967296.0 + _limbs[i];
+  }
+  return _negative ? -x : x;
+}
+
+// the decimal representation
+std::string Big_Int::to_string() const
+{
+  if (_limbs.empty())
+  {
+    return "0";
+  }
+
+  // powers[k] is 10 ^ (9 * 2^k), up to the first one bigger than this
+  std::vector<Limbs> powers;
+  powers.push_back(Limbs{1000000000});
+  while (compare_limbs(powers.back(), _limbs) <= 0)
+  {
+    powers.push_back(multiply_limbs(powers.back(), powers.back()));
+  }
+
+  std::string text;
+  text.reserve(9 << (powers.size() - 1));
+  if (_negative)
+  {
+    text += '-';
+  }
+  append_decimal(_limbs, powers, powers.size() - 1, false, text);
+  return text;
+}
+
+bool Big_Int::is_zero() const
+{
+  return _limbs.empty();
+}
+
+bool Big_Int::negative() const
+{
+  return _negative;
+}
+
+// the number of significant bits in the magnitude
+size_t Big_Int::bits() const
+{
+  if (_limbs.empty())
+  {
+    return 0;
+  }
+  return _limbs.size() * 32 - __builtin_clz(_limbs.back());
+}
+
+// -1, 0 or 1 as a is less than, equal to or greater than b
+int Big_Int::compare(const Big_Int &a, const Big_Int &b)
+{
+  if (a._negative != b._negative)
+  {
+    return a._negative ? -1 : 1;
+  }
+  int result = compare_limbs(a._limbs, b._limbs);
+  return a._negative ? -result : result;
+}
+
+// quotient and remainder of a / b, b must not be zero
+void Big_Int::divide(const Big_Int &a, const Big_Int &b, Big_Int &quotient, Big_Int &remainder)
+{
+  Limbs q, r;
+  divide_limbs(a._limbs, b._limbs, q, r);
+  quotient._limbs = std::move(q);
+  quotient._negative = a._negative != b._negative;
+  quotient.trim();
+  remainder._limbs = std::move(r);
+  remainder._negative = a._negative;
+  remainder.trim();
+}
+
+// this ^ exp by repeated squaring
+Big_Int Big_Int::pow(unsigned long long exp) const
+{
+  Big_Int result(1), base = *this;
+  while (true)
+  {
+    if (exp & 1)
+    {
+      result = result * base;
+    }
+    exp >>= 1;
+    if (exp == 0)
+    {
+      break;
+    }
+    base = base * base;
+  }
+  return result;
+}
+
+Big_Int Big_Int::operator-() const
+{
+  Big_Int result = *this;
+  result._negative = not _negative;
+  result.trim();
+  return result;
+}
+
+Big_Int operator+(const Big_Int &a, const Big_Int &b)
+{
+  return Big_Int::add(a, b, false);
+}
+
+Big_Int operator-(const Big_Int &a, const Big_Int &b)
+{
+  return Big_Int::add(a, b, true);
+}
+
+Big_Int operator*(const Big_Int &a, const Big_Int &b)
+{
+  Big_Int result;
+  result._limbs = multiply_limbs(a._limbs, b._limbs);
+  result._negative = a._negative != b._negative;
+  result.trim();
+  return result;
+}
+
+// strip leading zero limbs (and the sign of zero)
+void Big_Int::trim()
+{
+  trim_limbs(_limbs);
+  if (_limbs.empty())
+  {
+    _negative = false;
+  }
+}
+
+// sum or difference of a and b, where b is negated if subtract is set
+Big_Int Big_Int::add(const Big_Int &a, const Big_Int &b, bool subtract)
+{
+  bool b_negative = b._negative != subtract;
+
+  Big_Int result;
+  if (a._negative == b_negative)
+  {
+    result._limbs = add_limbs(a._limbs, b._limbs);
+    result._negative = a._negative;
+  }
+  else if (compare_limbs(a._limbs, b._limbs) >= 0)
+  {
+    result._limbs = subtract_limbs(a._limbs, b._limbs);
+    result._negative = a._negative;
+  }
+  else
+  {
+    result._limbs = subtract_limbs(b._limbs, a._limbs);
+    result._negative = b_negative;
+  }
+  result.trim();
+  return result;
+}
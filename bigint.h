@@ -0,0 +1,66 @@
+// File: bigint.h
+// Purpose: Arbitrary precision integers, for integer results which do not
+//          fit in 64 bits.
+#ifndef BIGINT_H
+#define BIGINT_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A sign and a magnitude stored as base 2^32 limbs, least significant
+// first, with no leading zero limbs (so zero has no limbs at all).
+// Division and remainder truncate toward zero, as they do for long long.
+class Big_Int
+{
+public:
+  Big_Int();
+  Big_Int(long long value);
+
+  // parse an optionally signed string of decimal digits, false if invalid
+  static bool parse(std::string_view text, Big_Int &result);
+
+  // true if the value fits in a long long
+  bool fits() const;
+
+  // the value as a long long (saturating) or as the nearest double
+  long long to_integer() const;
+  double to_real() const;
+
+  // the decimal representation
+  std::string to_string() const;
+
+  bool is_zero() const;
+  bool negative() const;
+
+  // the number of significant bits in the magnitude
+  size_t bits() const;
+
+  // -1, 0 or 1 as a is less than, equal to or greater than b
+  static int compare(const Big_Int &a, const Big_Int &b);
+
+  // quotient and remainder of a / b, b must not be zero
+  static void divide(const Big_Int &a, const Big_Int &b, Big_Int &quotient, Big_Int &remainder);
+
+  // this ^ exp by repeated squaring
+  Big_Int pow(unsigned long long exp) const;
+
+  Big_Int operator-() const;
+  friend Big_Int operator+(const Big_Int &a, const Big_Int &b);
+  friend Big_Int operator-(const Big_Int &a, const Big_Int &b);
+  friend Big_Int operator*(const Big_Int &a, const Big_Int &b);
+
+private:
+  typedef std::vector<uint32_t> Limbs;
+
+  bool _negative;
+  Limbs _limbs;
+
+  // strip leading zero limbs (and the sign of zero)
+  void trim();
+
+  // sum or difference of a and b, where b is negated if subtract is set
+  static Big_Int add(const Big_Int &a, const Big_Int &b, bool subtract);
+};
+
+#endif
@@ -0,0 +1,74 @@
+// File: bigint_bench.cpp
+// Purpose: Time big integer arithmetic through the VM: factorial(10000),
+//          fib(100000) and 3 ^ 200000, and the time to print each result.
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "lexer.h"
+#include "parser.h"
+#include "ref_env.h"
+#include "scope.h"
+#include "vm.h"
+
+// products of small numbers into one big one
+static const char *factorial =
+  "result = 1\n"
+  "i = 2\n"
+  "while i <= n\n"
+  "  result = result * i\n"
+  "  i = i + 1\n"
+  "end while\n";
+
+// sums of two big numbers
+static const char *fib =
+  "a = 0\n"
+  "result = 1\n"
+  "i = 1\n"
+  "while i < n\n"
+  "  t = a + result\n"
+  "  a = result\n"
+  "  result = t\n"
+  "  i = i + 1\n"
+  "end while\n";
+
+// squares of big numbers (Karatsuba)
+static const char *power = "result = 3 ^ n\n";
+
+// run program with n set, and report the time taken and to print result
+static void time_program(const char *name, const char *program, int n)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  Lexer lexer(program);
+  Parser parser(&lexer);
+  Parse_Tree *tree = parser.parse();
+
+  Ref_Env env;
+  EvalResult limit;
+  limit.set(n);
+  env.set("n", limit);
+  resolve(tree, env.scope());
+
+  Compiler compiler;
+  Chunk *chunk = compiler.compile(tree);
+  VM vm;
+  vm.run(chunk, &env);
+  delete chunk;
+
+  auto computed = std::chrono::steady_clock::now();
+  EvalResult result = env.get("result");
+  std::string digits = result.type() == BIGINT ? result.as_big()->to_string() : "";
+  auto printed = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double> compute = computed - start;
+  std::chrono::duration<double> print = printed - computed;
+  std::cout << name << "(" << n << "): " << digits.size() << " digits, computed in "
+            << compute.count() * 1000 << "ms, printed in " << print.count() * 1000 << "ms" << std::endl;
+}
+
+int main()
+{
+  time_program("factorial", factorial, 10000);
+  time_program("fib", fib, 100000);
+  time_program("3 ^", power, 200000);
+}
@@ -1,13 +1,24 @@
 // File: calc.cpp
 // Purpose: This is an implementation of the calc interpreter
+#include "batch_input.h"
+#include "company_db.h"
 #include "lexer.h"
+#include "mapped_file.h"
+#include "output.h"
 #include "parse_tree.h"
 #include "parser.h"
+#include "ref_env.h"
+#include "scope.h"
+#include "vm.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <limits>
-#include <fstream>
+#include <memory>
+#include <vector>
+#include <unistd.h>
 
 // REPL (Read Execute Print Loop) interface
 void calc_repl();
@@ -15,17 +26,105 @@ void calc_repl();
 // Run the contents of a file
 void calc_run(const std::string &filename);
 
+// Run a parsed program with the selected evaluator
+EvalResult calc_eval(Parse_Tree *program, Ref_Env *env, Arena &arena);
+
+// use the tree walking evaluator instead of the VM (--tree)
+static bool tree_walk = false;
+
+// simplify programs before running them (-O)
+static bool optimize_tree = false;
+
+// write output as soon as it is printed (--unbuffered)
+static bool unbuffered = false;
+
+// read input without prompts, in large blocks (--batch, or --interactive to
+// prompt anyway); the default is batch when stdin is not a terminal
+static bool batch_input = not isatty(STDIN_FILENO);
+
+// when DB writes reach the journal (--write-batch N, --write-delay MS and
+// --sync none|flush|write); by default each is written as it is made
+static Write_Policy write_policy;
+
 int main(int argc, char **argv) {
-  if(argc == 1) {
+  std::string filename;
+
+  // process the options
+  for(int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if(arg == "--tree") {
+      tree_walk = true;
+    } else if(arg == "-O") {
+      optimize_tree = true;
+    } else if(arg == "--unbuffered") {
+      unbuffered = true;
+    } else if(arg == "--batch") {
+      batch_input = true;
+    } else if(arg == "--interactive") {
+      batch_input = false;
+    } else if(arg == "--write-batch" and i + 1 < argc) {
+      write_policy.batch = std::max(1, atoi(argv[++i]));
+    } else if(arg == "--write-delay" and i + 1 < argc) {
+      write_policy.delay = std::max(0, atoi(argv[++i]));
+    } else if(arg == "--sync" and i + 1 < argc) {
+      std::string level = argv[++i];
+      if(level == "none") {
+        write_policy.sync = SYNC_NONE;
+      } else if(level == "flush") {
+        write_policy.sync = SYNC_FLUSH;
+      } else if(level == "write") {
+        write_policy.sync = SYNC_WRITE;
+      } else {
+        std::cerr << "Unknown sync level: " << level << std::endl;
+        return 1;
+      }
+    } else {
+      filename = arg;
+    }
+  }
+
+  // everything the program prints goes through one buffer, flushed at
+  // input prompts and at exit (it is static so exit() flushes it too)
+  static Output output(not unbuffered);
+  Company_DB::set_write_policy(write_policy);
+
+  if(filename.empty()) {
     calc_repl();
   } else {
-    calc_run(argv[1]);
+    calc_run(filename);
   }
 }
 
+// Run a parsed program with the selected evaluator
+EvalResult calc_eval(Parse_Tree *program, Ref_Env *env, Arena &arena) {
+  if(optimize_tree) {
+    program = optimize(program, arena);
+  }
+
+  // bind the program's variables to slots in the environment
+  resolve(program, env->scope());
+
+  if(tree_walk) {
+    return program->eval(env);
+  }
+
+  // compile and run the program on the VM
+  Compiler compiler;
+  Chunk *chunk = compiler.compile(program);
+  VM vm;
+  EvalResult result = vm.run(chunk, env);
+  delete chunk;
+
+  return result;
+}
+
 // REPL (Read Execute Print Loop) interface
 void calc_repl() {
   std::string line;
+  // each line is parsed into its own arena, which is freed after it runs;
+  // the arenas of lines which define functions are kept, as their closures
+  // may be called on later lines
+  std::vector<std::unique_ptr<Arena>> functions;
   Ref_Env env; //global environment
 
   while (std::cin) {
@@ -40,20 +139,26 @@ void calc_repl() {
     std::istringstream is(line + "\n");
 
     // make our lexer and parser
+    std::unique_ptr<Arena> arena(new Arena);
     Lexer lexer(is);
-    Parser parser(&lexer);
+    Parser parser(&lexer, arena.get());
     Parse_Tree *program = parser.parse();
 
     // run the program and display the result
-    EvalResult result = program->eval(&env);
+    EvalResult result = calc_eval(program, &env, *arena);
     if(result.type() == INTEGER) {
       std::cout << result.as_integer() << std::endl;
     } else if(result.type() == REAL) {
       std::cout << result.as_real() << std::endl;
+    } else if(result.type() == BIGINT) {
+      std::cout << result.as_big()->to_string() << std::endl;
+    } else if(result.type() == DECIMAL) {
+      std::cout << result.as_decimal().to_string() << std::endl;
     }
 
-    // cleanup
-    delete program;
+    if(parser.defines_functions()) {
+      functions.push_back(std::move(arena));
+    }
   }
 }
 
@@ -61,21 +166,23 @@ void calc_repl() {
 // Run the contents of a file
 void calc_run(const std::string &filename)
 {
-  std::ifstream file;
-  file.open(filename);
-  if(!file) {
+  Mapped_File file(filename);
+  if(!file.ok()) {
     std::cerr << "Could not open file: " << filename << std::endl;
     return;
   }
 
-  // create a lexer/parser for the file
-  Lexer lexer(file);
-  Parser parser(&lexer);
+  // create a lexer/parser for the file, lexing it in place
+  Arena arena;
+  Lexer lexer(file.text());
+  Parser parser(&lexer, &arena);
   Parse_Tree *program = parser.parse();
 
-  // run the program
+  // run the program, taking its input from the batch reader if there is one
+  std::unique_ptr<Batch_Input> batch;
+  if(batch_input) {
+    batch.reset(new Batch_Input);
+  }
   Ref_Env env;
-  program->eval(&env);
-
-  delete program;
+  calc_eval(program, &env, arena);
 }
\ No newline at end of file
@@ -0,0 +1,1734 @@
+// File: company_db.cpp
+// Purpose: Implementation of the company DB files.
+#include "company_db.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the journal may grow to this size before it is compacted, however small
+// the snapshot is
+static const size_t compact_size = 1 << 20;
+
+// A binary snapshot is a header followed by one column per field, each
+// starting on an 8 byte boundary. All numbers are 64 bit, in the byte order
+// of the machine which wrote them. A string column is the offset of the end
+// of each string, followed by the strings' text; salaries and prices are
+// counts of millionths (as Decimal holds them); and a customer's purchases
+// run from the end of the previous customer's to the end given for theirs.
+enum Column
+{
+  EMPLOYEE_NAME, EMPLOYEE_EMAIL, EMPLOYEE_PHONE, EMPLOYEE_SALARY,
+  CUSTOMER_NAME, CUSTOMER_EMAIL, CUSTOMER_PHONE, CUSTOMER_PURCHASES,
+  PURCHASE_ITEM, PURCHASE_QUANTITY, PURCHASE_PRICE,
+  COLUMN_COUNT
+};
+
+struct Binary_Header
+{
+  char magic[8];
+  uint64_t employees;
+  uint64_t customers;
+  uint64_t purchases;
+  uint64_t columns[COLUMN_COUNT];  // offset of each column in the file
+};
+
+static const char binary_magic[8] = {'C', 'A', 'L', 'C', 'D', 'B', '1', '\n'};
+
+// An index file is a header followed by the hash table of each index, in
+// the order of DB_Key. It matches a snapshot if the snapshot's size and
+// modification time are the ones it was built for.
+struct Index_Header
+{
+  char magic[8];
+  uint64_t snapshot_size;
+  uint64_t snapshot_modified;
+  uint64_t records[DB_KEY_COUNT];  // the records each table covers
+  uint64_t slots[DB_KEY_COUNT];
+};
+
+static const char index_magic[8] = {'C', 'A', 'L', 'C', 'I', 'X', '1', '\n'};
+
+// Snapshots in either format end with a footer line, "checksum " and 16 hex
+// digits, holding the checksum of everything before it. A snapshot whose
+// footer does not match was torn by a crash; one with no footer was written
+// before footers were added, and is read as it is.
+static const std::string_view footer_tag = "checksum ";
+static const size_t footer_size = 9 + 16 + 1;
+
+Write_Policy Company_DB::_policy;
+
+// the open DBs, by file name
+static std::unordered_map<std::string, std::unique_ptr<Company_DB>> open_dbs;
+
+// read a whole line of the journal, false if it was cut short
+static bool read_line(std::istream &in, std::string &line)
+{
+  return std::getline(in, line) and not in.eof();
+}
+
+// One record of a journal. A purchase's item is kept in name, and its price
+// in amount.
+struct Journal_Record
+{
+  std::string kind;
+  std::string name, email, phone;
+  Decimal amount;
+  long long customer;  // numbered from 1
+  long long quantity;
+};
+
+// read the next record of the journal, false at the end or if it was cut
+// short or garbled
+static bool read_record(std::istream &in, Journal_Record &record)
+{
+  std::string number, count, money;
+  if (not read_line(in, record.kind))
+  {
+    return false;
+  }
+  if (record.kind == "employee")
+  {
+    return read_line(in, record.name) and read_line(in, record.email) and read_line(in, record.phone) and
+           read_line(in, money) and Decimal::parse(money, record.amount);
+  }
+  if (record.kind == "customer")
+  {
+    return read_line(in, record.name) and read_line(in, record.email) and read_line(in, record.phone);
+  }
+  if (record.kind == "purchase")
+  {
+    if (not (read_line(in, number) and read_line(in, record.name) and read_line(in, count) and
+             read_line(in, money) and Decimal::parse(money, record.amount)))
+    {
+      return false;
+    }
+    record.customer = record.quantity = 0;
+    std::from_chars(number.data(), number.data() + number.size(), record.customer);
+    std::from_chars(count.data(), count.data() + count.size(), record.quantity);
+    return true;
+  }
+  return false;
+}
+
+// the header of a journal which follows a snapshot with these records
+static std::string header_of_journal(size_t employees, size_t customers, size_t purchases)
+{
+  return "journal " + std::to_string(employees) + " " + std::to_string(customers) + " " +
+         std::to_string(purchases);
+}
+
+// add a line to a journal record
+static void add_line(std::string &record, std::string_view line)
+{
+  record.append(line.data(), line.size());
+  record += '\n';
+}
+
+// a 64 bit number from a binary snapshot (which may not be aligned)
+static uint64_t word_at(const char *data)
+{
+  uint64_t word;
+  memcpy(&word, data, sizeof word);
+  return word;
+}
+
+// the checksum of a snapshot. Words are mixed into four lanes, so their
+// multiplies overlap, and read in little endian order, so that a text
+// snapshot can be checked on any machine.
+static uint64_t checksum(std::string_view data)
+{
+  const uint64_t prime = 0x9e3779b97f4a7c15ull;
+  uint64_t lanes[4] = {1, 2, 3, 4};
+  char last[32] = {};
+  size_t whole = data.size() & ~(size_t)31;
+  memcpy(last, data.data() + whole, data.size() - whole);
+  for (size_t at = 0; at <= whole; at += 32)
+  {
+    const char *block = at < whole ? data.data() + at : last;
+    for (int lane = 0; lane < 4; lane++)
+    {
+      uint64_t word = word_at(block + 8 * lane);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      word = __builtin_bswap64(word);
+#endif
+      lanes[lane] = (lanes[lane] ^ word) * prime;
+      lanes[lane] ^= lanes[lane] >> 32;
+    }
+  }
+
+  uint64_t sum = data.size();
+  for (uint64_t lane : lanes)
+  {
+    sum = (sum ^ lane) * prime;
+    sum ^= sum >> 32;
+  }
+  return sum;
+}
+
+// the footer line of a snapshot with this checksum
+static std::string footer_of(uint64_t sum)
+{
+  char footer[footer_size + 1];
+  snprintf(footer, sizeof footer, "checksum %016llx\n", (unsigned long long)sum);
+  return footer;
+}
+
+// How closely a snapshot is checked when it is read. A snapshot with a
+// previous one beside it must have a footer, as only saves which write one
+// keep the previous snapshot; a footer at the end shows the end was
+// written. The checksum itself means reading the whole file, which would
+// undo reading a binary snapshot in place, so it is only compared when a
+// save may have been cut short: when a journal is beside the snapshot (a
+// compaction removes it after the new snapshot is in place) or save left
+// its temporary file. The previous snapshot is always checked in full.
+struct Footer_Check
+{
+  bool required;
+  bool verify;
+};
+
+static Footer_Check footer_check(const std::string &filename)
+{
+  bool interrupted = access((filename + ".journal").c_str(), F_OK) == 0 or
+                     access((filename + ".tmp").c_str(), F_OK) == 0;
+  return Footer_Check{access((filename + ".prev").c_str(), F_OK) == 0, interrupted};
+}
+
+static const Footer_Check previous_check = {false, true};
+
+// take the footer off a snapshot, false if the snapshot is torn
+static bool check_footer(std::string_view &data, Footer_Check check)
+{
+  if (data.size() < footer_size or data.substr(data.size() - footer_size, footer_tag.size()) != footer_tag)
+  {
+    return not check.required;
+  }
+  std::string_view footer = data.substr(data.size() - footer_size);
+  data.remove_suffix(footer_size);
+  return not check.verify or footer == footer_of(checksum(data));
+}
+
+// sync a file or directory to disk
+static bool sync_path(const std::string &path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  bool ok = fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+// the directory a file is in
+static std::string directory_of(const std::string &filename)
+{
+  size_t slash = filename.rfind('/');
+  return slash == std::string::npos ? "." : slash == 0 ? "/" : filename.substr(0, slash);
+}
+
+// Reads a text snapshot in place, the way the stream operators used to.
+class Text_Reader
+{
+public:
+  Text_Reader(std::string_view text) : _text(text), _at(0) {}
+
+  // skip spaces and read a number, false if there is none
+  bool number(long long &value)
+  {
+    skip_space();
+    const char *last = _text.data() + _text.size();
+    std::from_chars_result result = std::from_chars(_text.data() + _at, last, value);
+    if (result.ec != std::errc())
+    {
+      return false;
+    }
+    _at = result.ptr - _text.data();
+    return true;
+  }
+
+  // skip spaces and read an amount of money, which has six places
+  bool money(Decimal &amount)
+  {
+    skip_space();
+    size_t start = _at;
+    while (_at < _text.size() and not std::isspace((unsigned char)_text[_at]))
+    {
+      _at++;
+    }
+    return Decimal::parse(_text.substr(start, _at - start), amount);
+  }
+
+  // the rest of the line, consuming its newline
+  std::string_view line()
+  {
+    size_t start = _at;
+    const char *newline = (const char *)memchr(_text.data() + _at, '\n', _text.size() - _at);
+    size_t end = newline ? newline - _text.data() : _text.size();
+    _at = newline ? end + 1 : end;
+    return _text.substr(start, end - start);
+  }
+
+  void skip_char()
+  {
+    if (_at < _text.size())
+    {
+      _at++;
+    }
+  }
+
+  void skip_space()
+  {
+    while (_at < _text.size() and std::isspace((unsigned char)_text[_at]))
+    {
+      _at++;
+    }
+  }
+
+  // true if only spaces are left
+  bool at_end()
+  {
+    skip_space();
+    return _at == _text.size();
+  }
+
+private:
+  std::string_view _text;
+  size_t _at;
+};
+
+String_Column::String_Column() : _ends(nullptr), _mapped(0)
+{
+}
+
+// use the column of count strings at offset in a binary snapshot
+bool String_Column::map(std::string_view data, uint64_t offset, size_t count)
+{
+  if (offset > data.size() or count > (data.size() - offset) / 8)
+  {
+    return false;
+  }
+  _ends = data.data() + offset;
+  uint64_t text = offset + 8 * count;
+  uint64_t size = count == 0 ? 0 : word_at(_ends + 8 * (count - 1));
+  if (size > data.size() - text)
+  {
+    return false;
+  }
+  _text = data.substr(text, size);
+  _mapped = count;
+  _listed.clear();
+  return true;
+}
+
+void String_Column::push_back(std::string_view text)
+{
+  _listed.push_back(text);
+}
+
+size_t String_Column::size() const
+{
+  return _mapped + _listed.size();
+}
+
+// the i'th entry (empty if a mapped column is corrupt)
+std::string_view String_Column::operator[](size_t i) const
+{
+  if (i >= _mapped)
+  {
+    return _listed[i - _mapped];
+  }
+  uint64_t begin = i == 0 ? 0 : word_at(_ends + 8 * (i - 1));
+  uint64_t end = word_at(_ends + 8 * i);
+  if (begin > end or end > _text.size())
+  {
+    return std::string_view();
+  }
+  return _text.substr(begin, end - begin);
+}
+
+Number_Column::Number_Column() : _values(nullptr), _mapped(0)
+{
+}
+
+// use the column of count numbers at offset in a binary snapshot
+bool Number_Column::map(std::string_view data, uint64_t offset, size_t count)
+{
+  if (offset > data.size() or count > (data.size() - offset) / 8)
+  {
+    return false;
+  }
+  _values = data.data() + offset;
+  _mapped = count;
+  _listed.clear();
+  return true;
+}
+
+void Number_Column::push_back(long long value)
+{
+  _listed.push_back(value);
+}
+
+size_t Number_Column::size() const
+{
+  return _mapped + _listed.size();
+}
+
+long long Number_Column::operator[](size_t i) const
+{
+  return i < _mapped ? (long long)word_at(_values + 8 * i) : _listed[i - _mapped];
+}
+
+Hash_Index::Hash_Index() : _table(nullptr), _slots(0), _records(0)
+{
+}
+
+// use the table of slots at table, which covers the first records entries
+void Hash_Index::map(const char *table, size_t slots, size_t records)
+{
+  _table = table;
+  _slots = slots;
+  _records = records;
+  _built.clear();
+  _added.clear();
+}
+
+// build a table covering all of the column, at most half full
+void Hash_Index::build(const String_Column &column)
+{
+  size_t slots = 8;
+  while (slots < 2 * column.size())
+  {
+    slots *= 2;
+  }
+  _built.assign(slots, 0);
+  for (size_t i = 0; i < column.size(); i++)
+  {
+    size_t slot = hash(column[i]) & (slots - 1);
+    while (_built[slot] != 0)
+    {
+      slot = (slot + 1) & (slots - 1);
+    }
+    _built[slot] = i + 1;
+  }
+  _table = (const char *)_built.data();
+  _slots = slots;
+  _records = column.size();
+  _added.clear();
+}
+
+// index entry record of the column, which was added after the table
+void Hash_Index::add(const String_Column &column, size_t record)
+{
+  _added[column[record]].push_back(record);
+}
+
+// the records whose entry is key, in order
+void Hash_Index::find(const String_Column &column, std::string_view key, std::vector<size_t> &result) const
+{
+  result.clear();
+  if (_slots > 0)
+  {
+    // probe from the key's slot to the next empty one
+    size_t slot = hash(key) & (_slots - 1);
+    for (size_t probes = 0; probes < _slots; probes++)
+    {
+      uint64_t entry = word_at(_table + 8 * slot);
+      if (entry == 0)
+      {
+        break;
+      }
+      if (entry <= _records and column[entry - 1] == key)
+      {
+        result.push_back(entry - 1);
+      }
+      slot = (slot + 1) & (_slots - 1);
+    }
+    std::sort(result.begin(), result.end());
+  }
+
+  auto added = _added.find(key);
+  if (added != _added.end())
+  {
+    result.insert(result.end(), added->second.begin(), added->second.end());
+  }
+}
+
+// write out a table which was built
+void Hash_Index::write(std::ostream &out) const
+{
+  out.write((const char *)_built.data(), _built.size() * sizeof(uint64_t));
+}
+
+size_t Hash_Index::slots() const
+{
+  return _slots;
+}
+
+size_t Hash_Index::records() const
+{
+  return _records;
+}
+
+// the hash of a key (64 bit FNV-1a)
+uint64_t Hash_Index::hash(std::string_view key)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : key)
+  {
+    hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// the time on a clock which only goes forward, in milliseconds
+static long long now_ms()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// by default every record is written as it is made, and not synced
+Write_Policy::Write_Policy() : batch(1), delay(0), sync(SYNC_NONE)
+{
+}
+
+Company_DB::Company_DB()
+    : _indexed(false), _base_employees(0), _base_customers(0), _base_purchases(0),
+      _has_snapshot(false), _recovered(false), _format(TEXT_DB), _snapshot_size(0), _journal_size(0),
+      _journal(-1), _pending_records(0), _pending_since(0)
+{
+}
+
+// the open DBs are destroyed at exit, which is when their held records are
+// written if nothing else wrote them
+Company_DB::~Company_DB()
+{
+  if (not flush())
+  {
+    fprintf(stderr, "Failed to write to file %s\n", _filename.c_str());
+  }
+  close_journal();
+}
+
+// the DB in the file, from the cache if the file has not changed
+Company_DB *Company_DB::open(const std::string &filename)
+{
+  std::unique_ptr<Company_DB> &db = open_dbs[filename];
+  if (not db)
+  {
+    db.reset(new Company_DB);
+  }
+  else if (not db->changed())
+  {
+    return db.get();
+  }
+  else
+  {
+    // records made here go in before whatever changed the files
+    db->flush();
+  }
+
+  if (not db->load(filename))
+  {
+    open_dbs.erase(filename);
+    return nullptr;
+  }
+  return db.get();
+}
+
+// compact every open DB which is dirty
+bool Company_DB::compact_all()
+{
+  bool ok = true;
+  for (auto &entry : open_dbs)
+  {
+    if (entry.second->dirty() and not entry.second->compact())
+    {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// how records written to every DB reach its journal
+void Company_DB::set_write_policy(const Write_Policy &policy)
+{
+  _policy = policy;
+}
+
+// write the records every open DB holds
+bool Company_DB::flush_all()
+{
+  bool ok = true;
+  for (auto &entry : open_dbs)
+  {
+    if (not entry.second->flush())
+    {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// write the records which have been held for longer than the delay
+bool Company_DB::flush_due()
+{
+  bool ok = true;
+  for (auto &entry : open_dbs)
+  {
+    if (entry.second->flush_is_due() and not entry.second->flush())
+    {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// read the snapshot and replay the journal
+bool Company_DB::load(const std::string &filename)
+{
+  close_journal();
+  _filename = filename;
+  _snapshot.reset();
+  _added.reset(new Arena);
+  clear_records();
+  _indexed = false;
+  _index_file.reset();
+  _has_snapshot = false;
+  _recovered = false;
+  _snapshot_size = 0;
+  _journal_size = 0;
+  _pending.clear();
+  _pending_records = 0;
+
+  // new DBs are binary if they are named for it
+  _format = filename.size() > 4 and filename.compare(filename.size() - 4, 4, ".cdb") == 0 ? BINARY_DB : TEXT_DB;
+
+  std::unique_ptr<Mapped_File> snapshot(new Mapped_File(filename));
+  if (snapshot->ok())
+  {
+    // a torn snapshot is passed over for the one it replaced
+    std::string_view data = snapshot->text();
+    if (not (check_footer(data, footer_check(_filename)) and read_snapshot(data)))
+    {
+      clear_records();
+      snapshot.reset(new Mapped_File(previous_name()));
+      data = snapshot->text();
+      if (not (snapshot->ok() and check_footer(data, previous_check) and read_snapshot(data)))
+      {
+        _filename.clear();
+        return false;
+      }
+      _recovered = true;
+
+      // the previous snapshot takes the torn one's place, as the journal
+      // which showed it was torn will not match, and replay removes it
+      std::string temporary = _filename + ".tmp";
+      std::remove(temporary.c_str());
+      if (link(previous_name().c_str(), temporary.c_str()) != 0 or
+          std::rename(temporary.c_str(), _filename.c_str()) != 0)
+      {
+        std::remove(temporary.c_str());
+      }
+    }
+    _snapshot_size = snapshot->text().size();
+    _snapshot = std::move(snapshot);
+    _has_snapshot = true;
+  }
+  _base_employees = employee_count();
+  _base_customers = customer_count();
+  _base_purchases = _purchase_item.size();
+
+  std::ifstream journal(journal_name());
+  if (journal.is_open())
+  {
+    replay(journal);
+  }
+
+  // replaying may have cleaned up the journal, so take its stamp after
+  _snapshot_stamp = File_Stamp::of(_filename);
+  _journal_stamp = File_Stamp::of(journal_name());
+  return true;
+}
+
+// forget every record
+void Company_DB::clear_records()
+{
+  _employee_name = _employee_email = _employee_phone = String_Column();
+  _customer_name = _customer_email = _customer_phone = _purchase_item = String_Column();
+  _employee_salary = _customer_purchases = _purchase_quantity = _purchase_price = Number_Column();
+  _added_purchases.clear();
+}
+
+// index a snapshot in either format (without its footer), false if it is
+// not a DB
+bool Company_DB::read_snapshot(std::string_view data)
+{
+  _format = data.substr(0, sizeof binary_magic) == std::string_view(binary_magic, sizeof binary_magic) ? BINARY_DB : TEXT_DB;
+  return _format == BINARY_DB ? read_binary(data) : read_text(data);
+}
+
+// the file last loaded
+const std::string &Company_DB::filename() const
+{
+  return _filename;
+}
+
+// true if the loaded DB has been saved
+bool Company_DB::exists() const
+{
+  return _has_snapshot;
+}
+
+// the format of the snapshot
+DB_Format Company_DB::format() const
+{
+  return _format;
+}
+
+size_t Company_DB::employee_count() const
+{
+  return _employee_name.size();
+}
+
+Employee Company_DB::employee(size_t i) const
+{
+  return Employee{_employee_name[i], _employee_email[i], _employee_phone[i], Decimal::from_units(_employee_salary[i])};
+}
+
+size_t Company_DB::customer_count() const
+{
+  return _customer_name.size();
+}
+
+Customer Company_DB::customer(size_t i) const
+{
+  return Customer{_customer_name[i], _customer_email[i], _customer_phone[i]};
+}
+
+std::string_view Company_DB::customer_name(size_t i) const
+{
+  return _customer_name[i];
+}
+
+// the purchases of customer i, in the order they were made
+void Company_DB::purchases(size_t customer, std::vector<Purchase> &result) const
+{
+  std::vector<size_t> indexes;
+  purchase_indexes(customer, indexes);
+  result.clear();
+  for (size_t i : indexes)
+  {
+    result.push_back(Purchase{_purchase_item[i], Decimal::from_units(_purchase_price[i]), _purchase_quantity[i]});
+  }
+}
+
+// where the purchases of customer i are in the purchase columns: those in
+// the snapshot, then those made since
+void Company_DB::purchase_indexes(size_t customer, std::vector<size_t> &result) const
+{
+  result.clear();
+  if (customer < _customer_purchases.size())
+  {
+    long long begin = customer == 0 ? 0 : _customer_purchases[customer - 1];
+    long long end = _customer_purchases[customer];
+    for (long long i = begin < 0 ? 0 : begin; i < end and i < (long long)_purchase_item.size(); i++)
+    {
+      result.push_back(i);
+    }
+  }
+
+  auto added = _added_purchases.find(customer);
+  if (added != _added_purchases.end())
+  {
+    result.insert(result.end(), added->second.begin(), added->second.end());
+  }
+}
+
+// the numbers of the records whose field is value
+void Company_DB::find(DB_Key key, std::string_view value, std::vector<size_t> &result)
+{
+  if (not _indexed and not read_indexes())
+  {
+    build_indexes();
+  }
+  _indexes[key].find(key_column(key), value, result);
+}
+
+// the column a key is in
+const String_Column &Company_DB::key_column(DB_Key key) const
+{
+  switch (key)
+  {
+  case EMPLOYEE_NAME_KEY: return _employee_name;
+  case EMPLOYEE_EMAIL_KEY: return _employee_email;
+  case CUSTOMER_NAME_KEY: return _customer_name;
+  default: return _customer_email;
+  }
+}
+
+// use the index file if it matches the snapshot
+bool Company_DB::read_indexes()
+{
+  std::unique_ptr<Mapped_File> file(new Mapped_File(index_name()));
+  Index_Header header;
+  std::string_view data = file->text();
+  if (_recovered or not file->ok() or data.size() < sizeof header)
+  {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof header);
+  if (memcmp(header.magic, index_magic, sizeof index_magic) != 0 or
+      header.snapshot_size != (uint64_t)_snapshot_stamp.size or
+      header.snapshot_modified != (uint64_t)_snapshot_stamp.modified)
+  {
+    return false;
+  }
+
+  // each table must fit, and cover no more records than there are now
+  uint64_t offset = sizeof header;
+  for (int key = 0; key < DB_KEY_COUNT; key++)
+  {
+    uint64_t slots = header.slots[key];
+    if (slots == 0 or (slots & (slots - 1)) != 0 or slots > (data.size() - offset) / 8 or
+        header.records[key] > key_column((DB_Key)key).size())
+    {
+      return false;
+    }
+    offset += 8 * slots;
+  }
+
+  // the records added since the file was written are indexed here
+  offset = sizeof header;
+  for (int key = 0; key < DB_KEY_COUNT; key++)
+  {
+    _indexes[key].map(data.data() + offset, header.slots[key], header.records[key]);
+    offset += 8 * header.slots[key];
+    for (size_t i = header.records[key]; i < key_column((DB_Key)key).size(); i++)
+    {
+      _indexes[key].add(key_column((DB_Key)key), i);
+    }
+  }
+  _index_file = std::move(file);
+  _indexed = true;
+  return true;
+}
+
+// build the indexes over every record and save them beside the snapshot
+void Company_DB::build_indexes()
+{
+  Index_Header header = {};
+  memcpy(header.magic, index_magic, sizeof index_magic);
+  header.snapshot_size = _snapshot_stamp.size;
+  header.snapshot_modified = _snapshot_stamp.modified;
+  for (int key = 0; key < DB_KEY_COUNT; key++)
+  {
+    _indexes[key].build(key_column((DB_Key)key));
+    header.records[key] = _indexes[key].records();
+    header.slots[key] = _indexes[key].slots();
+  }
+  _index_file.reset();
+  _indexed = true;
+
+  // a DB which has not been saved (or was read from the previous snapshot)
+  // has nothing to match the file to
+  if (not _has_snapshot or _recovered)
+  {
+    return;
+  }
+  std::string temporary = index_name() + ".tmp";
+  std::ofstream out(temporary, std::ios::binary);
+  out.write((const char *)&header, sizeof header);
+  for (const Hash_Index &index : _indexes)
+  {
+    index.write(out);
+  }
+  out.close();
+  if (out.fail() or std::rename(temporary.c_str(), index_name().c_str()) != 0)
+  {
+    std::remove(temporary.c_str());
+  }
+}
+
+// index a record which has just been added
+void Company_DB::index_record(DB_Key key, size_t record)
+{
+  if (_indexed)
+  {
+    _indexes[key].add(key_column(key), record);
+  }
+}
+
+bool Company_DB::add_employee(const Employee &employee)
+{
+  insert_employee(employee);
+  std::string record = "employee\n";
+  add_line(record, employee.name);
+  add_line(record, employee.email);
+  add_line(record, employee.phone);
+  add_line(record, employee.salary.to_fixed());
+  return append(record);
+}
+
+bool Company_DB::add_customer(const Customer &customer)
+{
+  insert_customer(customer);
+  std::string record = "customer\n";
+  add_line(record, customer.name);
+  add_line(record, customer.email);
+  add_line(record, customer.phone);
+  return append(record);
+}
+
+bool Company_DB::add_purchase(long long customer, const Purchase &purchase)
+{
+  if (customer <= 0 or customer > (long long)customer_count())
+  {
+    return false;
+  }
+  insert_purchase(customer - 1, purchase);
+  std::string record = "purchase\n";
+  add_line(record, std::to_string(customer));
+  add_line(record, purchase.itemName);
+  add_line(record, std::to_string(purchase.quantity));
+  add_line(record, purchase.price.to_fixed());
+  return append(record);
+}
+
+// add a record in memory, copying its fields
+void Company_DB::insert_employee(const Employee &employee)
+{
+  _employee_name.push_back(_added->intern(employee.name));
+  _employee_email.push_back(_added->intern(employee.email));
+  _employee_phone.push_back(_added->intern(employee.phone));
+  _employee_salary.push_back(employee.salary.units());
+  index_record(EMPLOYEE_NAME_KEY, _employee_name.size() - 1);
+  index_record(EMPLOYEE_EMAIL_KEY, _employee_email.size() - 1);
+}
+
+void Company_DB::insert_customer(const Customer &customer)
+{
+  _customer_name.push_back(_added->intern(customer.name));
+  _customer_email.push_back(_added->intern(customer.email));
+  _customer_phone.push_back(_added->intern(customer.phone));
+  index_record(CUSTOMER_NAME_KEY, _customer_name.size() - 1);
+  index_record(CUSTOMER_EMAIL_KEY, _customer_email.size() - 1);
+}
+
+void Company_DB::insert_purchase(size_t customer, const Purchase &purchase)
+{
+  _added_purchases[customer].push_back(_purchase_item.size());
+  _purchase_item.push_back(_added->intern(purchase.itemName));
+  _purchase_quantity.push_back(purchase.quantity);
+  _purchase_price.push_back(purchase.price.units());
+}
+
+// true if records have been written since the snapshot
+bool Company_DB::dirty() const
+{
+  return _journal_size > 0 or not _pending.empty();
+}
+
+// true if the files were changed by something else since they were read
+bool Company_DB::changed() const
+{
+  return _filename.empty() or not (File_Stamp::of(_filename) == _snapshot_stamp and
+                                   File_Stamp::of(journal_name()) == _journal_stamp);
+}
+
+// write everything to a new snapshot and remove the journal
+bool Company_DB::compact()
+{
+  if (_filename.empty())
+  {
+    return false;
+  }
+
+  if (not save(_filename, _format))
+  {
+    return false;
+  }
+
+  // the journal and the records held for it are now part of the snapshot
+  close_journal();
+  std::remove(journal_name().c_str());
+  _has_snapshot = true;
+  _recovered = false;
+  _journal_size = 0;
+  _pending.clear();
+  _pending_records = 0;
+  _base_employees = employee_count();
+  _base_customers = customer_count();
+  _base_purchases = _purchase_item.size();
+  _snapshot_stamp = File_Stamp::of(_filename);
+  _journal_stamp = File_Stamp::of(journal_name());
+  _snapshot_size = _snapshot_stamp.size;
+
+  // indexes which are in use are saved for the new snapshot
+  if (_indexed)
+  {
+    build_indexes();
+  }
+  return true;
+}
+
+// write everything to a snapshot in the given format, followed by its
+// checksum. It is written beside the file, synced if the write policy syncs,
+// and then renamed over the file, as the file may be mapped by this DB. The
+// file it replaces is kept as the previous snapshot (the file name with
+// ".prev" added) for loading to fall back on, unless that is where this DB
+// came from.
+bool Company_DB::save(const std::string &filename, DB_Format format) const
+{
+  std::string temporary = filename + ".tmp";
+  std::ofstream out(temporary, std::ios::binary);
+  if (format == BINARY_DB)
+  {
+    write_binary(out);
+  }
+  else
+  {
+    write_text(out);
+  }
+  out.close();
+
+  // the binary writer goes back over its header, so the checksum is taken
+  // from the file once it is written
+  bool ok = not out.fail();
+  if (ok)
+  {
+    Mapped_File written(temporary);
+    std::string footer = footer_of(checksum(written.text()));
+    out.open(temporary, std::ios::binary | std::ios::app);
+    out.write(footer.data(), footer.size());
+    out.close();
+    ok = written.ok() and not out.fail();
+  }
+  if (not ok or (_policy.sync != SYNC_NONE and not sync_path(temporary)))
+  {
+    std::remove(temporary.c_str());
+    return false;
+  }
+
+  std::string previous = filename + ".prev";
+  if (not (_recovered and filename == _filename))
+  {
+    std::remove(previous.c_str());
+    link(filename.c_str(), previous.c_str());
+  }
+  if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+  {
+    std::remove(temporary.c_str());
+    return false;
+  }
+
+  // the rename is only durable once the directory is synced
+  return _policy.sync == SYNC_NONE or sync_path(directory_of(filename));
+}
+
+bool Company_DB::File_Stamp::operator==(const File_Stamp &other) const
+{
+  return exists == other.exists and size == other.size and modified == other.modified;
+}
+
+// the status of the file now
+Company_DB::File_Stamp Company_DB::File_Stamp::of(const std::string &filename)
+{
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0)
+  {
+    return File_Stamp{false, 0, 0};
+  }
+  return File_Stamp{true, (long long)info.st_size, info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec};
+}
+
+std::string Company_DB::journal_name() const
+{
+  return _filename + ".journal";
+}
+
+std::string Company_DB::previous_name() const
+{
+  return _filename + ".prev";
+}
+
+std::string Company_DB::index_name() const
+{
+  return _filename + ".index";
+}
+
+// index a text snapshot, false if it is not a DB
+bool Company_DB::read_text(std::string_view data)
+{
+  Text_Reader in(data);
+  long long numEmployees = 0;
+  if (not in.number(numEmployees))
+  {
+    return false;
+  }
+  for (long long i = 0; i < numEmployees; ++i)
+  {
+    Decimal salary;
+    in.skip_char(); // the newline after the number of employees, or the salary
+    _employee_name.push_back(in.line());
+    _employee_email.push_back(in.line());
+    _employee_phone.push_back(in.line());
+    if (not in.money(salary))
+    {
+      return false;
+    }
+    _employee_salary.push_back(salary.units());
+  }
+
+  // a DB without customers has no customer count
+  long long numCustomers = 0;
+  if (not in.number(numCustomers))
+  {
+    return in.at_end();
+  }
+  in.line();
+
+  for (long long i = 0; i < numCustomers; ++i)
+  {
+    in.skip_space();
+    _customer_name.push_back(in.line());
+    _customer_email.push_back(in.line());
+    _customer_phone.push_back(in.line());
+
+    long long numPurchases = 0;
+    if (not in.number(numPurchases))
+    {
+      return false;
+    }
+    in.line();
+
+    for (long long j = 0; j < numPurchases; ++j)
+    {
+      long long quantity = 0;
+      Decimal price;
+      in.skip_space();
+      _purchase_item.push_back(in.line());
+      if (not (in.number(quantity) and in.money(price)))
+      {
+        return false;
+      }
+      in.line();
+      _purchase_quantity.push_back(quantity);
+      _purchase_price.push_back(price.units());
+    }
+    _customer_purchases.push_back(_purchase_item.size());
+  }
+  return true;
+}
+
+// index a binary snapshot, false if it is not a DB
+bool Company_DB::read_binary(std::string_view data)
+{
+  Binary_Header header;
+  if (data.size() < sizeof header)
+  {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof header);
+  const uint64_t *at = header.columns;
+  uint64_t employees = header.employees, customers = header.customers, purchases = header.purchases;
+
+  // only the extent of each column is checked here; fields are checked as
+  // they are read, so loading does not touch the columns themselves
+  return _employee_name.map(data, at[EMPLOYEE_NAME], employees) and
+         _employee_email.map(data, at[EMPLOYEE_EMAIL], employees) and
+         _employee_phone.map(data, at[EMPLOYEE_PHONE], employees) and
+         _employee_salary.map(data, at[EMPLOYEE_SALARY], employees) and
+         _customer_name.map(data, at[CUSTOMER_NAME], customers) and
+         _customer_email.map(data, at[CUSTOMER_EMAIL], customers) and
+         _customer_phone.map(data, at[CUSTOMER_PHONE], customers) and
+         _customer_purchases.map(data, at[CUSTOMER_PURCHASES], customers) and
+         _purchase_item.map(data, at[PURCHASE_ITEM], purchases) and
+         _purchase_quantity.map(data, at[PURCHASE_QUANTITY], purchases) and
+         _purchase_price.map(data, at[PURCHASE_PRICE], purchases);
+}
+
+void Company_DB::write_text(std::ostream &out) const
+{
+  out << employee_count() << "\n";
+  for (size_t i = 0; i < employee_count(); i++)
+  {
+    Employee employee = this->employee(i);
+    out << employee.name << "\n" << employee.email << "\n" << employee.phone << "\n"
+        << employee.salary.to_fixed() << "\n";
+  }
+
+  // a DB without customers has no customer count
+  if (customer_count() > 0)
+  {
+    std::vector<Purchase> bought;
+    out << customer_count() << "\n";
+    for (size_t i = 0; i < customer_count(); i++)
+    {
+      Customer customer = this->customer(i);
+      purchases(i, bought);
+      out << customer.name << "\n" << customer.email << "\n" << customer.phone << "\n";
+      out << bought.size() << "\n";
+      for (const Purchase &purchase : bought)
+      {
+        out << purchase.itemName << "\n" << purchase.quantity << "\n" << purchase.price.to_fixed() << "\n";
+      }
+    }
+  }
+}
+
+// write a 64 bit number
+static void put_word(std::ostream &out, uint64_t word)
+{
+  out.write((const char *)&word, sizeof word);
+}
+
+// start a column on an 8 byte boundary, returning its offset
+static uint64_t start_column(std::ostream &out)
+{
+  static const char zeros[8] = {};
+  uint64_t offset = out.tellp();
+  out.write(zeros, -offset & 7);
+  return (offset + 7) & ~(uint64_t)7;
+}
+
+// write a column of count strings, where field(i) is the i'th
+template <class Field>
+static uint64_t put_strings(std::ostream &out, size_t count, Field field)
+{
+  uint64_t offset = start_column(out), end = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    end += field(i).size();
+    put_word(out, end);
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    std::string_view text = field(i);
+    out.write(text.data(), text.size());
+  }
+  return offset;
+}
+
+// write a column of count numbers, where field(i) is the i'th
+template <class Field>
+static uint64_t put_words(std::ostream &out, size_t count, Field field)
+{
+  uint64_t offset = start_column(out);
+  for (size_t i = 0; i < count; i++)
+  {
+    put_word(out, field(i));
+  }
+  return offset;
+}
+
+void Company_DB::write_binary(std::ostream &out) const
+{
+  // the purchases are written in customer order, with the end of each
+  // customer's
+  std::vector<size_t> order, indexes;
+  std::vector<uint64_t> ends;
+  order.reserve(_purchase_item.size());
+  for (size_t i = 0; i < customer_count(); i++)
+  {
+    purchase_indexes(i, indexes);
+    order.insert(order.end(), indexes.begin(), indexes.end());
+    ends.push_back(order.size());
+  }
+
+  // the header is written again once the columns are in place
+  Binary_Header header = {};
+  memcpy(header.magic, binary_magic, sizeof binary_magic);
+  header.employees = employee_count();
+  header.customers = customer_count();
+  header.purchases = order.size();
+  out.write((const char *)&header, sizeof header);
+  uint64_t *at = header.columns;
+
+  at[EMPLOYEE_NAME] = put_strings(out, header.employees, [&](size_t i) { return _employee_name[i]; });
+  at[EMPLOYEE_EMAIL] = put_strings(out, header.employees, [&](size_t i) { return _employee_email[i]; });
+  at[EMPLOYEE_PHONE] = put_strings(out, header.employees, [&](size_t i) { return _employee_phone[i]; });
+  at[EMPLOYEE_SALARY] = put_words(out, header.employees, [&](size_t i) { return _employee_salary[i]; });
+  at[CUSTOMER_NAME] = put_strings(out, header.customers, [&](size_t i) { return _customer_name[i]; });
+  at[CUSTOMER_EMAIL] = put_strings(out, header.customers, [&](size_t i) { return _customer_email[i]; });
+  at[CUSTOMER_PHONE] = put_strings(out, header.customers, [&](size_t i) { return _customer_phone[i]; });
+  at[CUSTOMER_PURCHASES] = put_words(out, header.customers, [&](size_t i) { return ends[i]; });
+  at[PURCHASE_ITEM] = put_strings(out, header.purchases, [&](size_t i) { return _purchase_item[order[i]]; });
+  at[PURCHASE_QUANTITY] = put_words(out, header.purchases, [&](size_t i) { return _purchase_quantity[order[i]]; });
+  at[PURCHASE_PRICE] = put_words(out, header.purchases, [&](size_t i) { return _purchase_price[order[i]]; });
+
+  out.seekp(0);
+  out.write((const char *)&header, sizeof header);
+}
+
+// replay the journal onto the snapshot. A journal which was written after
+// an older snapshot has already been folded in and is removed; a record cut
+// short by a crash is dropped, so the next one is written after a whole one.
+void Company_DB::replay(std::istream &in)
+{
+  std::string header;
+  if (not read_line(in, header) or header != journal_header())
+  {
+    std::remove(journal_name().c_str());
+    return;
+  }
+
+  std::streamoff good = in.tellg();
+  Journal_Record record;
+  while (read_record(in, record))
+  {
+    if (record.kind == "employee")
+    {
+      insert_employee(Employee{record.name, record.email, record.phone, record.amount});
+    }
+    else if (record.kind == "customer")
+    {
+      insert_customer(Customer{record.name, record.email, record.phone});
+    }
+    else if (record.customer > 0 and record.customer <= (long long)customer_count())
+    {
+      insert_purchase(record.customer - 1, Purchase{record.name, record.amount, record.quantity});
+    }
+    good = in.tellg();
+  }
+
+  _journal_size = good;
+  in.clear();
+  in.seekg(0, std::ios::end);
+  if (in.tellg() != good)
+  {
+    truncate(journal_name().c_str(), good);
+  }
+}
+
+// the header which ties the journal to the snapshot it follows
+std::string Company_DB::journal_header() const
+{
+  return header_of_journal(_base_employees, _base_customers, _base_purchases);
+}
+
+// add a record to the journal, writing it out when the policy says, and
+// compacting the journal if it has grown too big
+bool Company_DB::append(const std::string &record)
+{
+  // a new DB gets its snapshot straight away
+  if (not _has_snapshot)
+  {
+    return compact();
+  }
+
+  if (_pending.empty())
+  {
+    _pending_since = now_ms();
+  }
+  _pending += record;
+  _pending_records++;
+  if ((_pending_records >= _policy.batch or _policy.sync == SYNC_WRITE or flush_is_due()) and not flush())
+  {
+    return false;
+  }
+
+  size_t size = _journal_size + _pending.size();
+  if (size > compact_size and size > _snapshot_size)
+  {
+    return compact();
+  }
+  return true;
+}
+
+// true if the held records should be written by now
+bool Company_DB::flush_is_due() const
+{
+  return not _pending.empty() and _policy.delay > 0 and now_ms() - _pending_since >= _policy.delay;
+}
+
+// write the records held in memory to the journal in one go
+bool Company_DB::flush()
+{
+  if (_pending.empty())
+  {
+    return true;
+  }
+
+  std::string text;
+  if (_journal < 0)
+  {
+    _journal = ::open(journal_name().c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (_journal < 0)
+    {
+      return false;
+    }
+    if (_journal_size == 0)
+    {
+      text = journal_header() + "\n";
+    }
+  }
+  text += _pending;
+
+  const char *data = text.data();
+  size_t size = text.size();
+  while (size > 0)
+  {
+    ssize_t written = ::write(_journal, data, size);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  if (_policy.sync != SYNC_NONE and fdatasync(_journal) != 0)
+  {
+    return false;
+  }
+
+  _journal_size += text.size();
+  _journal_stamp = File_Stamp::of(journal_name());
+  _pending.clear();
+  _pending_records = 0;
+  return true;
+}
+
+void Company_DB::close_journal()
+{
+  if (_journal >= 0)
+  {
+    ::close(_journal);
+    _journal = -1;
+  }
+}
+
+Purchase_Totals::Purchase_Totals() : purchases(0), quantity(0), overflow(false)
+{
+}
+
+void Purchase_Totals::add(const Purchase &purchase)
+{
+  Decimal count, cost;
+  purchases++;
+  if (__builtin_add_overflow(quantity, purchase.quantity, &quantity) or
+      not (Decimal::from_integer(purchase.quantity, count) and Decimal::multiply(count, purchase.price, cost) and
+           Decimal::add(revenue, cost, revenue)))
+  {
+    overflow = true;
+  }
+}
+
+void Purchase_Totals::add(const Purchase_Totals &totals)
+{
+  purchases += totals.purchases;
+  if (totals.overflow or __builtin_add_overflow(quantity, totals.quantity, &quantity) or
+      not Decimal::add(revenue, totals.revenue, revenue))
+  {
+    overflow = true;
+  }
+}
+
+Purchase_Visitor::~Purchase_Visitor()
+{
+}
+
+// the numbers of each kind of record in a snapshot
+struct Record_Counts
+{
+  size_t employees;
+  size_t customers;
+  size_t purchases;
+};
+
+// a visitor which ignores everything, for counting the records of a snapshot
+class Count_Visitor : public Purchase_Visitor
+{
+public:
+  void purchase(const Purchase &) override {}
+  void customer(size_t, const Customer &, const Purchase_Totals &) override {}
+};
+
+// The records of a journal, held while the snapshot it follows is scanned.
+// A journal is small beside its snapshot (it is compacted once it outgrows
+// it), so it is read up front, and the totals of purchases made since the
+// snapshot are added to their customers as the snapshot goes by.
+class Journal_Totals
+{
+public:
+  Journal_Totals() : _found(false), _employees(0), _customers(0), _purchases(0), _used(false) {}
+
+  // read the journal, which may be missing
+  void read(const std::string &filename)
+  {
+    std::ifstream in(filename);
+    std::string header;
+    if (not read_line(in, header) or
+        sscanf(header.c_str(), "journal %zu %zu %zu", &_employees, &_customers, &_purchases) != 3)
+    {
+      return;
+    }
+    _found = true;
+
+    // records are read as far as a replay would take them
+    Journal_Record record;
+    while (read_record(in, record))
+    {
+      if (record.kind == "customer")
+      {
+        _added.push_back(Customer{_text.intern(record.name), _text.intern(record.email), _text.intern(record.phone)});
+      }
+      else if (record.kind == "purchase" and record.customer > 0 and
+               record.customer <= (long long)(_customers + _added.size()))
+      {
+        Purchase purchase{_text.intern(record.name), record.amount, record.quantity};
+        _bought.push_back(purchase);
+        _totals[record.customer - 1].add(purchase);
+      }
+    }
+  }
+
+  // true if there is a journal
+  bool found() const
+  {
+    return _found;
+  }
+
+  // use the journal if it follows a snapshot with these records; one which
+  // does not was left by a compaction which crashed, and is skipped as
+  // replay() skips it
+  void start(const Record_Counts &snapshot)
+  {
+    _used = _found and snapshot.employees == _employees and snapshot.customers == _customers and
+            snapshot.purchases == _purchases;
+  }
+
+  // add the purchases made since the snapshot by customer (from 0)
+  void add_to(size_t customer, Purchase_Totals &totals) const
+  {
+    auto found = _totals.find(customer);
+    if (_used and found != _totals.end())
+    {
+      totals.add(found->second);
+    }
+  }
+
+  // report the purchases, and the customers who follow the snapshot's
+  void report(Purchase_Visitor &visitor) const
+  {
+    if (not _used)
+    {
+      return;
+    }
+    for (const Purchase &purchase : _bought)
+    {
+      visitor.purchase(purchase);
+    }
+    for (size_t i = 0; i < _added.size(); i++)
+    {
+      Purchase_Totals totals;
+      add_to(_customers + i, totals);
+      visitor.customer(_customers + i + 1, _added[i], totals);
+    }
+  }
+
+private:
+  bool _found;
+  size_t _employees;  // the snapshot's records, from the header
+  size_t _customers;
+  size_t _purchases;
+  bool _used;
+  Arena _text;
+  std::vector<Customer> _added;
+  std::vector<Purchase> _bought;
+  std::unordered_map<size_t, Purchase_Totals> _totals;
+};
+
+// scan a text snapshot the way read_text indexes it, counting its records
+static bool scan_text(std::string_view data, const Journal_Totals &journal, Purchase_Visitor &visitor,
+                      Record_Counts &counts)
+{
+  counts = Record_Counts{0, 0, 0};
+  Text_Reader in(data);
+  long long numEmployees = 0;
+  if (not in.number(numEmployees))
+  {
+    return false;
+  }
+  for (long long i = 0; i < numEmployees; ++i)
+  {
+    Decimal salary;
+    in.skip_char();
+    in.line();
+    in.line();
+    in.line();
+    if (not in.money(salary))
+    {
+      return false;
+    }
+    counts.employees++;
+  }
+
+  long long numCustomers = 0;
+  if (not in.number(numCustomers))
+  {
+    return in.at_end();
+  }
+  in.line();
+
+  for (long long i = 0; i < numCustomers; ++i)
+  {
+    Customer customer;
+    in.skip_space();
+    customer.name = in.line();
+    customer.email = in.line();
+    customer.phone = in.line();
+
+    long long numPurchases = 0;
+    if (not in.number(numPurchases))
+    {
+      return false;
+    }
+    in.line();
+
+    Purchase_Totals totals;
+    for (long long j = 0; j < numPurchases; ++j)
+    {
+      Purchase purchase;
+      in.skip_space();
+      purchase.itemName = in.line();
+      if (not (in.number(purchase.quantity) and in.money(purchase.price)))
+      {
+        return false;
+      }
+      in.line();
+      visitor.purchase(purchase);
+      totals.add(purchase);
+      counts.purchases++;
+    }
+    journal.add_to(i, totals);
+    visitor.customer(i + 1, customer, totals);
+    counts.customers++;
+  }
+  return true;
+}
+
+// the records of a binary snapshot, from its header
+static bool binary_counts(std::string_view data, Record_Counts &counts)
+{
+  Binary_Header header;
+  if (data.size() < sizeof header)
+  {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof header);
+  counts = Record_Counts{header.employees, header.customers, header.purchases};
+  return true;
+}
+
+// scan a binary snapshot, reading the columns it needs side by side
+static bool scan_binary(std::string_view data, const Journal_Totals &journal, Purchase_Visitor &visitor)
+{
+  Binary_Header header;
+  if (data.size() < sizeof header)
+  {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof header);
+  const uint64_t *at = header.columns;
+  String_Column name, email, phone, item;
+  Number_Column ends, quantity, price;
+  if (not (name.map(data, at[CUSTOMER_NAME], header.customers) and
+           email.map(data, at[CUSTOMER_EMAIL], header.customers) and
+           phone.map(data, at[CUSTOMER_PHONE], header.customers) and
+           ends.map(data, at[CUSTOMER_PURCHASES], header.customers) and
+           item.map(data, at[PURCHASE_ITEM], header.purchases) and
+           quantity.map(data, at[PURCHASE_QUANTITY], header.purchases) and
+           price.map(data, at[PURCHASE_PRICE], header.purchases)))
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < header.customers; i++)
+  {
+    Purchase_Totals totals;
+    long long begin = i == 0 ? 0 : ends[i - 1];
+    for (long long j = begin < 0 ? 0 : begin; j < ends[i] and j < (long long)header.purchases; j++)
+    {
+      Purchase purchase{item[j], Decimal::from_units(price[j]), quantity[j]};
+      visitor.purchase(purchase);
+      totals.add(purchase);
+    }
+    journal.add_to(i, totals);
+    visitor.customer(i + 1, Customer{name[i], email[i], phone[i]}, totals);
+  }
+  return true;
+}
+
+// A scan reads the snapshot in place, as loading does, but keeps none of
+// it: the mapping is only read from front to back, so pages behind the scan
+// can be dropped and the file may be far bigger than memory. The journal
+// is checked against the snapshot's counts before any record is visited;
+// a text snapshot only gives its count of purchases at the end, so when
+// there is a journal it is read through once to count them first.
+bool Company_DB::scan(const std::string &filename, Purchase_Visitor &visitor)
+{
+  // records this interpreter is holding go to the journal first
+  auto open = open_dbs.find(filename);
+  if (open != open_dbs.end() and not open->second->flush())
+  {
+    return false;
+  }
+
+  std::unique_ptr<Mapped_File> snapshot(new Mapped_File(filename));
+  if (not snapshot->ok())
+  {
+    return false;
+  }
+
+  // a torn snapshot is passed over for the one it replaced, as load does
+  std::string previous = filename + ".prev";
+  std::string_view data = snapshot->text();
+  if (not check_footer(data, footer_check(filename)))
+  {
+    snapshot.reset(new Mapped_File(previous));
+    data = snapshot->text();
+    if (not (snapshot->ok() and check_footer(data, previous_check)))
+    {
+      return false;
+    }
+  }
+  Journal_Totals journal;
+  journal.read(filename + ".journal");
+
+  bool binary = data.substr(0, sizeof binary_magic) == std::string_view(binary_magic, sizeof binary_magic);
+  if (journal.found())
+  {
+    Record_Counts counts;
+    Count_Visitor count;
+    if (not (binary ? binary_counts(data, counts) : scan_text(data, Journal_Totals(), count, counts)))
+    {
+      return false;
+    }
+    journal.start(counts);
+  }
+
+  Record_Counts counts;
+  if (not (binary ? scan_binary(data, journal, visitor) : scan_text(data, journal, visitor, counts)))
+  {
+    return false;
+  }
+  journal.report(visitor);
+  return true;
+}
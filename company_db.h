@@ -0,0 +1,400 @@
+// File: company_db.h
+// Purpose: The records of the company DB and the files they are kept in.
+#ifndef COMPANY_DB_H
+#define COMPANY_DB_H
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "decimal.h"
+
+class Mapped_File;
+
+// The fields of records are views of the DB's memory mapped snapshot, or of
+// the copies it keeps of records added since. They stay valid until the DB
+// is loaded again.
+struct Employee
+{
+  std::string_view name;
+  std::string_view email;
+  std::string_view phone;
+  Decimal salary;
+};
+
+struct Purchase
+{
+  std::string_view itemName;
+  Decimal price;
+  long long quantity;
+};
+
+struct Customer
+{
+  std::string_view name;
+  std::string_view email;
+  std::string_view phone;
+};
+
+// the totals of a number of purchases
+struct Purchase_Totals
+{
+  long long purchases;
+  long long quantity;
+  Decimal revenue;  // the sum of quantity times price
+  bool overflow;    // true if the quantity or revenue was too big to hold
+
+  Purchase_Totals();
+  void add(const Purchase &purchase);
+  void add(const Purchase_Totals &totals);
+};
+
+// What a scan of a DB file is reported to (see Company_DB::scan). The
+// fields of records are only valid during the call.
+class Purchase_Visitor
+{
+public:
+  virtual ~Purchase_Visitor();
+
+  // each purchase, in the order they are read
+  virtual void purchase(const Purchase &purchase) = 0;
+
+  // each customer, numbered from 1, with the totals of their purchases
+  virtual void customer(size_t number, const Customer &customer, const Purchase_Totals &totals) = 0;
+};
+
+// One field of a table of records: the entries of a column in a binary
+// snapshot, read in place in the mapping, followed by entries listed one at
+// a time (the lines of a text snapshot, and records added since).
+class String_Column
+{
+public:
+  String_Column();
+
+  // use the column of count strings at offset in a binary snapshot, false
+  // if it does not fit in the data
+  bool map(std::string_view data, uint64_t offset, size_t count);
+
+  void push_back(std::string_view text);
+  size_t size() const;
+
+  // the i'th entry (empty if a mapped column is corrupt)
+  std::string_view operator[](size_t i) const;
+
+private:
+  const char *_ends;   // end offset of each mapped string, unaligned
+  std::string_view _text;
+  size_t _mapped;
+  std::vector<std::string_view> _listed;
+};
+
+class Number_Column
+{
+public:
+  Number_Column();
+
+  // use the column of count numbers at offset in a binary snapshot, false
+  // if it does not fit in the data
+  bool map(std::string_view data, uint64_t offset, size_t count);
+
+  void push_back(long long value);
+  size_t size() const;
+  long long operator[](size_t i) const;
+
+private:
+  const char *_values;  // unaligned
+  size_t _mapped;
+  std::vector<long long> _listed;
+};
+
+// An index from the entries of a string column to the records which have
+// them. It is a hash table of record numbers, which may be mapped from an
+// index file, plus a list of the records added since the table was built.
+class Hash_Index
+{
+public:
+  Hash_Index();
+
+  // use the table of slots (a power of two) at table, which covers the
+  // first records entries of the column
+  void map(const char *table, size_t slots, size_t records);
+
+  // build a table covering all of the column
+  void build(const String_Column &column);
+
+  // index entry record of the column, which was added after the table
+  void add(const String_Column &column, size_t record);
+
+  // the records whose entry is key, in order
+  void find(const String_Column &column, std::string_view key, std::vector<size_t> &result) const;
+
+  // write out a table which was built
+  void write(std::ostream &out) const;
+
+  size_t slots() const;
+  size_t records() const;
+
+  // the hash of a key, which must not change as it is stored in files
+  static uint64_t hash(std::string_view key);
+
+private:
+  const char *_table;    // record number + 1 in each slot, 0 if it is empty
+  size_t _slots;
+  size_t _records;
+  std::vector<uint64_t> _built;
+  std::unordered_map<std::string_view, std::vector<size_t>> _added;
+};
+
+// the fields records can be found by
+enum DB_Key
+{
+  EMPLOYEE_NAME_KEY,
+  EMPLOYEE_EMAIL_KEY,
+  CUSTOMER_NAME_KEY,
+  CUSTOMER_EMAIL_KEY,
+  DB_KEY_COUNT
+};
+
+// the formats a DB snapshot can be stored in
+enum DB_Format
+{
+  TEXT_DB,    // counts and fields on separate lines
+  BINARY_DB   // a column for each field (see company_db.cpp)
+};
+
+// how far a record must get before a write to a DB is done
+enum DB_Sync
+{
+  SYNC_NONE,    // the journal is written, and the OS stores it when it likes
+  SYNC_FLUSH,   // the journal is synced to disk each time it is written
+  SYNC_WRITE    // each record is written and synced as it is made
+};
+
+// When records written to a DB reach its journal. Records are held in
+// memory until batch of them have been made, or the first has been held
+// for delay milliseconds (checked at each write and batch input), and then
+// are written together. Held records are also written before prompting for
+// input, when the DB is closed, reported on or reread, and at exit.
+struct Write_Policy
+{
+  size_t batch;     // 1 writes every record as it is made
+  long long delay;  // 0 for no limit
+  DB_Sync sync;
+
+  Write_Policy();
+};
+
+// A company DB is a snapshot in either format plus a journal (the file
+// name with ".journal" added) of the records written since the snapshot.
+// Snapshots are checksummed, and the one before the latest is kept (with
+// ".prev" added) so that a snapshot torn by a crash can be passed over.
+// Each write appends one record to the journal, so it costs the same however
+// big the DB is. The journal is folded into a new snapshot when the DB is
+// compacted: on close, or when the journal outgrows the snapshot (which
+// keeps the cost of compaction constant per record written).
+//
+// The snapshot is memory mapped and never copied: a text snapshot is
+// indexed line by line, and a binary one is used where it is, so a field is
+// only read when it is asked for. Open DBs are cached by file name, so a DB
+// is only read again when its files were changed by something other than
+// this interpreter.
+//
+// Records can be found by name and email through hash indexes, which are
+// kept in the file name with ".index" added. They are built the first time
+// they are used (if the index file is missing or does not match the
+// snapshot), kept up to date as records are added, and saved again when
+// the DB is compacted.
+class Company_DB
+{
+public:
+  Company_DB();
+  ~Company_DB();
+
+  // the DB in the file, from the cache if the file has not changed since
+  // it was read; nullptr if the file is not a DB
+  static Company_DB *open(const std::string &filename);
+
+  // compact every open DB which is dirty, false if one could not be written
+  static bool compact_all();
+
+  // how records written to every DB reach its journal
+  static void set_write_policy(const Write_Policy &policy);
+
+  // write the records every open DB holds, or only those which have been
+  // held for longer than the policy's delay; false if one could not be
+  // written
+  static bool flush_all();
+  static bool flush_due();
+
+  // read the customers and purchases in a DB file in one pass, without
+  // loading it; false if the file is missing or not a DB (see scan in
+  // company_db.cpp)
+  static bool scan(const std::string &filename, Purchase_Visitor &visitor);
+
+  // read the snapshot and replay the journal, false if the snapshot is not
+  // a DB (a missing snapshot is an empty DB)
+  bool load(const std::string &filename);
+
+  // the file last loaded, empty if there is none
+  const std::string &filename() const;
+
+  // true if the loaded DB has been saved (a DB is saved when it is created)
+  bool exists() const;
+
+  // the format of the snapshot; a new DB is binary if its name ends in .cdb
+  DB_Format format() const;
+
+  // records are numbered from 0
+  size_t employee_count() const;
+  Employee employee(size_t i) const;
+  size_t customer_count() const;
+  Customer customer(size_t i) const;
+  std::string_view customer_name(size_t i) const;
+
+  // the purchases of customer i, in the order they were made
+  void purchases(size_t customer, std::vector<Purchase> &result) const;
+
+  // the numbers of the records whose field is value
+  void find(DB_Key key, std::string_view value, std::vector<size_t> &result);
+
+  // add a record to the loaded DB and its journal, false if it could not be
+  // written; purchases are added to customers numbered from 1
+  bool add_employee(const Employee &employee);
+  bool add_customer(const Customer &customer);
+  bool add_purchase(long long customer, const Purchase &purchase);
+
+  // write the records held in memory to the journal, false if they could
+  // not be written
+  bool flush();
+
+  // true if records have been written since the snapshot
+  bool dirty() const;
+
+  // true if the files were changed by something else since they were read
+  bool changed() const;
+
+  // write everything to a new snapshot and remove the journal
+  bool compact();
+
+  // write everything to a snapshot in the given format, leaving the journal
+  // alone (this converts a DB from one format to the other); the file is
+  // replaced in one step, and kept as the previous snapshot
+  bool save(const std::string &filename, DB_Format format) const;
+
+private:
+  // enough of a file's status to tell if it has changed
+  struct File_Stamp
+  {
+    bool exists;
+    long long size;
+    long long modified;  // nanoseconds
+
+    bool operator==(const File_Stamp &other) const;
+    static File_Stamp of(const std::string &filename);
+  };
+
+  std::string _filename;
+  std::unique_ptr<Mapped_File> _snapshot;
+  std::unique_ptr<Arena> _added;  // the fields of records added since the snapshot
+
+  String_Column _employee_name;
+  String_Column _employee_email;
+  String_Column _employee_phone;
+  Number_Column _employee_salary;   // millionths
+  String_Column _customer_name;
+  String_Column _customer_email;
+  String_Column _customer_phone;
+  Number_Column _customer_purchases;  // end of each snapshot customer's purchases
+  String_Column _purchase_item;
+  Number_Column _purchase_quantity;
+  Number_Column _purchase_price;    // millionths
+
+  // the purchases made since the snapshot, by customer
+  std::unordered_map<size_t, std::vector<size_t>> _added_purchases;
+
+  // the indexes, once they have been read or built
+  bool _indexed;
+  Hash_Index _indexes[DB_KEY_COUNT];
+  std::unique_ptr<Mapped_File> _index_file;
+
+  // the number of records in the snapshot, which the journal starts from
+  size_t _base_employees;
+  size_t _base_customers;
+  size_t _base_purchases;
+
+  bool _has_snapshot;
+  bool _recovered;  // the snapshot was torn, and the previous one was read
+  DB_Format _format;
+  size_t _snapshot_size;
+  size_t _journal_size;
+  int _journal;  // descriptor the journal is appended to, -1 until it is opened
+
+  // the records which have not been written to the journal yet
+  std::string _pending;
+  size_t _pending_records;
+  long long _pending_since;  // milliseconds, on a steady clock
+
+  static Write_Policy _policy;
+
+  // the files as this DB last read or wrote them
+  File_Stamp _snapshot_stamp;
+  File_Stamp _journal_stamp;
+
+  std::string journal_name() const;
+  std::string previous_name() const;
+  std::string index_name() const;
+
+  // the column a key is in
+  const String_Column &key_column(DB_Key key) const;
+
+  // use the index file if it matches the snapshot, false if it does not
+  bool read_indexes();
+
+  // build the indexes over every record and save them
+  void build_indexes();
+
+  // index a record which has just been added
+  void index_record(DB_Key key, size_t record);
+
+  void clear_records();
+
+  // index a snapshot, false if it is not a DB
+  bool read_snapshot(std::string_view data);
+  bool read_text(std::string_view data);
+  bool read_binary(std::string_view data);
+
+  void write_text(std::ostream &out) const;
+  void write_binary(std::ostream &out) const;
+
+  // where the purchases of a customer are in the purchase columns
+  void purchase_indexes(size_t customer, std::vector<size_t> &result) const;
+
+  // add a record in memory, copying its fields
+  void insert_employee(const Employee &employee);
+  void insert_customer(const Customer &customer);
+  void insert_purchase(size_t customer, const Purchase &purchase);
+
+  // apply the journal's records to the snapshot
+  void replay(std::istream &in);
+
+  // the header which ties the journal to the snapshot it follows
+  std::string journal_header() const;
+
+  // add a record to the journal, writing it out when the policy says, and
+  // compacting the journal if it has grown too big
+  bool append(const std::string &record);
+
+  // true if the held records should be written by now
+  bool flush_is_due() const;
+
+  void close_journal();
+
+  // the DB owns an open journal, so it cannot be copied
+  Company_DB(const Company_DB &) = delete;
+  Company_DB &operator=(const Company_DB &) = delete;
+};
+
+#endif
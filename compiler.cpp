@@ -0,0 +1,332 @@
+// File: compiler.cpp
+// Purpose: Lowers the parse tree into bytecode for the VM.
+#include "vm.h"
+
+//////////////////////////////////////////
+// Chunk
+//////////////////////////////////////////
+Chunk::Chunk(Fun_Def *def)
+{
+  this->def = def;
+  this->arity = 0;
+}
+
+Chunk::~Chunk()
+{
+  for (Chunk *fun : functions)
+  {
+    delete fun;
+  }
+}
+
+//////////////////////////////////////////
+// Compiler
+//////////////////////////////////////////
+
+// compile a top level program
+Chunk *Compiler::compile(Parse_Tree *program)
+{
+  _chunk = new Chunk(nullptr);
+  program->compile(this);
+  emit(OP_RETURN);
+
+  return _chunk;
+}
+
+// emit an instruction, returning its address
+int Compiler::emit(Opcode op, int arg, int depth)
+{
+  _chunk->code.push_back({op, (unsigned short)depth, arg});
+  return (int)_chunk->code.size() - 1;
+}
+
+// the address of the next instruction
+int Compiler::here()
+{
+  return (int)_chunk->code.size();
+}
+
+// point the jump at address at to the next instruction
+void Compiler::patch(int at)
+{
+  _chunk->code[at].arg = here();
+}
+
+// store the value of a statement in the result register
+void Compiler::result()
+{
+  // VOID followed by RESULT just clears the register. The VOID may be a
+  // jump target, so it is rewritten in place rather than removed.
+  if (not _chunk->code.empty() and _chunk->code.back().op == OP_VOID)
+  {
+    _chunk->code.back().op = OP_CLEAR;
+  }
+  else
+  {
+    emit(OP_RESULT);
+  }
+}
+
+int Compiler::constant(EvalResult value)
+{
+  _chunk->constants.push_back(value);
+  return (int)_chunk->constants.size() - 1;
+}
+
+int Compiler::node(Parse_Tree *node)
+{
+  _chunk->nodes.push_back(node);
+  return (int)_chunk->nodes.size() - 1;
+}
+
+int Compiler::function(Fun_Def *def)
+{
+  Chunk *fun = new Chunk(def);
+  Parse_List *params = (Parse_List *)def->left();
+  fun->arity = (int)(params->end() - params->begin());
+
+  // compile the body into its own chunk
+  Chunk *outer = _chunk;
+  _chunk = fun;
+  def->right()->compile(this);
+  emit(OP_RETURN);
+  _chunk = outer;
+
+  _chunk->functions.push_back(fun);
+  return (int)_chunk->functions.size() - 1;
+}
+
+//////////////////////////////////////////
+// Node compilation
+//////////////////////////////////////////
+void Parse_Tree::compile(Compiler *c)
+{
+  // anything without its own instructions is run by the tree walker
+  c->emit(OP_EVAL, c->node(this));
+}
+
+// Programs leave nothing on the stack; each statement's value goes to the
+// result register so the last one is what the program returns.
+void Program::compile(Compiler *c)
+{
+  for (auto itr = begin(); itr != end(); itr++)
+  {
+    (*itr)->compile(c);
+    c->result();
+  }
+}
+
+void Add::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_ADD);
+}
+
+void Subtract::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_SUB);
+}
+
+void Multiply::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_MUL);
+}
+
+void Divide::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_DIV);
+}
+
+void Mod::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_MOD);
+}
+
+void Power::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_POW);
+}
+
+void Negation::compile(Compiler *c)
+{
+  child()->compile(c);
+  c->emit(OP_NEG);
+}
+
+void Square::compile(Compiler *c)
+{
+  child()->compile(c);
+  c->emit(OP_SQUARE);
+}
+
+void Constant::compile(Compiler *c)
+{
+  c->emit(OP_CONST, c->constant(value()));
+}
+
+void Literal::compile(Compiler *c)
+{
+  // literals do not depend on the environment
+  c->emit(OP_CONST, c->constant(eval(nullptr)));
+}
+
+void Variable::compile(Compiler *c)
+{
+  // shadowing variables are left to the tree walker's run time check
+  if (_slot < 0 or _shadows)
+  {
+    Parse_Tree::compile(c);
+    return;
+  }
+  c->emit(OP_LOAD, _slot, _depth);
+}
+
+void Assignment::compile(Compiler *c)
+{
+  Variable *v = dynamic_cast<Variable *>(left());
+  if (not v or v->slot() < 0 or v->shadows())
+  {
+    Parse_Tree::compile(c);
+    return;
+  }
+
+  right()->compile(c);
+  c->emit(OP_STORE, v->slot(), v->depth());
+  c->emit(OP_VOID);
+}
+
+void Display::compile(Compiler *c)
+{
+  child()->compile(c);
+  c->emit(OP_DISPLAY);
+}
+
+void Branch::compile(Compiler *c)
+{
+  left()->compile(c);
+  int skip = c->emit(OP_JUMP_IF_FALSE);
+  right()->compile(c);
+  c->patch(skip);
+  c->emit(OP_VOID);
+}
+
+void Loop::compile(Compiler *c)
+{
+  int top = c->here();
+  left()->compile(c);
+  int exit = c->emit(OP_JUMP_IF_FALSE);
+  right()->compile(c);
+  c->emit(OP_JUMP, top);
+  c->patch(exit);
+  c->emit(OP_VOID);
+}
+
+void Equal::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_EQ);
+}
+
+void Not_Equal::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_NE);
+}
+
+void Greater::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_GT);
+}
+
+void Less::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_LT);
+}
+
+void Less_or_Equal::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_LTE);
+}
+
+void Greater_or_Equal::compile(Compiler *c)
+{
+  left()->compile(c);
+  right()->compile(c);
+  c->emit(OP_GTE);
+}
+
+void Parse_List::compile(Compiler *c)
+{
+  c->emit(OP_VOID);
+}
+
+void Fun_Def::compile(Compiler *c)
+{
+  if (var.shadows())
+  {
+    Parse_Tree::compile(c);
+    return;
+  }
+
+  c->emit(OP_CLOSURE, c->function(this));
+  c->emit(OP_STORE, var.slot(), var.depth());
+  c->emit(OP_VOID);
+}
+
+void Fun_Call::compile(Compiler *c)
+{
+  Parse_List *args = (Parse_List *)right();
+
+  // push the function followed by its arguments
+  left()->compile(c);
+  for (auto itr = args->begin(); itr != args->end(); itr++)
+  {
+    (*itr)->compile(c);
+  }
+  int argc = (int)(args->end() - args->begin());
+
+  if (not _tail)
+  {
+    c->emit(OP_CALL, argc);
+    return;
+  }
+
+  // any guard which holds makes this an ordinary call
+  std::vector<int> guarded;
+  for (Parse_Tree *guard : _guards)
+  {
+    guard->compile(c);
+    int next = c->emit(OP_JUMP_IF_FALSE);
+    guarded.push_back(c->emit(OP_JUMP));
+    c->patch(next);
+  }
+
+  // (a tail call only falls through if it fails)
+  c->emit(OP_TAIL_CALL, argc, _discard);
+  int done = c->emit(OP_JUMP);
+  for (int at : guarded)
+  {
+    c->patch(at);
+  }
+  c->emit(OP_CALL, argc);
+  c->patch(done);
+}
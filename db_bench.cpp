@@ -0,0 +1,60 @@
+// File: db_bench.cpp
+// Purpose: Time loading and saving a large company DB in the text and binary
+//          formats (10 million purchases, or the number given).
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "company_db.h"
+
+// purchases per customer in the generated DB
+static const long purchases_each = 10;
+
+// time one step and report it with the size of the file it used
+template <class Step>
+static bool time_step(const char *name, const std::string &filename, Step step)
+{
+  auto start = std::chrono::steady_clock::now();
+  bool ok = step();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  std::cout << name << ": " << elapsed.count() << "s, " << (long)file.tellg() / 1000000 << "MB"
+            << (ok ? "" : " FAILED") << std::endl;
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  long purchases = argc > 1 ? std::stol(argv[1]) : 10000000;
+  long customers = (purchases + purchases_each - 1) / purchases_each;
+  std::string text = "db_bench.dat", binary = "db_bench.cdb";
+
+  // write the DB in the text format
+  {
+    std::ofstream out(text);
+    out << "2\nboss\nboss@acme.com\n555-0100\n90000.000000\n"
+        << "clerk\nclerk@acme.com\n555-0101\n30999.500000\n";
+    out << customers << "\n";
+    long left = purchases;
+    for (long i = 0; i < customers; i++) {
+      long count = left < purchases_each ? left : purchases_each;
+      left -= count;
+      out << "customer" << i << "\ncustomer" << i << "@mail.com\n555-" << i % 10000 << "\n" << count << "\n";
+      for (long j = 0; j < count; j++) {
+        out << "item" << j << "\n" << j + 1 << "\n" << j << ".250000\n";
+      }
+    }
+  }
+
+  Company_DB db;
+  bool ok = time_step("load text", text, [&] { return db.load(text); }) and
+            time_step("save binary", binary, [&] { return db.save(binary, BINARY_DB); }) and
+            time_step("load binary", binary, [&] { return db.load(binary); }) and
+            time_step("save text", text, [&] { return db.save(text, TEXT_DB); });
+
+  std::remove(text.c_str());
+  std::remove(binary.c_str());
+  return ok ? 0 : 1;
+}
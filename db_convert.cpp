@@ -0,0 +1,41 @@
+// File: db_convert.cpp
+// Purpose: Convert a company DB between the text and binary formats, e.g.
+//          "./db_convert acme.dat acme.cdb".
+#include <iostream>
+#include <string>
+#include "company_db.h"
+
+int main(int argc, char **argv)
+{
+  // the output is binary if it is named .cdb, unless told otherwise
+  std::string from, to, format;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--text" or arg == "--binary") {
+      format = arg;
+    } else if (from.empty()) {
+      from = arg;
+    } else {
+      to = arg;
+    }
+  }
+  if (to.empty()) {
+    std::cerr << "usage: db_convert [--text|--binary] from to" << std::endl;
+    return 1;
+  }
+  bool binary = format.empty() ? to.size() > 4 and to.compare(to.size() - 4, 4, ".cdb") == 0 : format == "--binary";
+
+  // the journal is replayed, so everything written to the DB is converted
+  Company_DB db;
+  if (not db.load(from) or not db.exists()) {
+    std::cerr << "Could not read DB: " << from << std::endl;
+    return 1;
+  }
+  if (not db.save(to, binary ? BINARY_DB : TEXT_DB)) {
+    std::cerr << "Could not write DB: " << to << std::endl;
+    return 1;
+  }
+  std::cout << db.employee_count() << " employees and " << db.customer_count() << " customers written to "
+            << to << (binary ? " (binary)" : " (text)") << std::endl;
+  return 0;
+}
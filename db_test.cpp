@@ -0,0 +1,107 @@
+// File: db_test.cpp
+// Purpose: Check that reports over a company DB file merge its journal only
+//          when the journal follows the snapshot, as loading does.
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "company_db.h"
+
+// one customer who made two purchases, $13 in all
+static const char *snapshot =
+  "0\n"
+  "1\n"
+  "alice\n"
+  "a@x\n"
+  "1\n"
+  "2\n"
+  "pen\n"
+  "2\n"
+  "1.500000\n"
+  "ink\n"
+  "1\n"
+  "10.000000\n";
+
+// a purchase of $20 written after a snapshot with the given counts
+static std::string journal(const char *header)
+{
+  return std::string(header) + "\npurchase\n1\nink\n2\n10.000000\n";
+}
+
+// totals everything a scan visits
+class Totals : public Purchase_Visitor
+{
+public:
+  void purchase(const Purchase &purchase) override
+  {
+    visited.add(purchase);
+  }
+
+  void customer(size_t number, const Customer &customer, const Purchase_Totals &totals) override
+  {
+    customers.add(totals);
+  }
+
+  Purchase_Totals visited;
+  Purchase_Totals customers;
+};
+
+static void write_file(const std::string &filename, const std::string &text)
+{
+  std::ofstream out(filename, std::ios::binary);
+  out << text;
+}
+
+// scan filename with the given journal beside it, checking the purchases
+// and revenue both ways of totalling them
+static bool check(const std::string &filename, const std::string &journal_text, long long purchases,
+                  const char *revenue)
+{
+  write_file(filename + ".journal", journal_text);
+  Totals totals;
+  bool scanned = Company_DB::scan(filename, totals);
+  std::remove((filename + ".journal").c_str());
+
+  bool ok = scanned and totals.visited.purchases == purchases and totals.customers.purchases == purchases and
+            totals.visited.revenue.to_string() == revenue and totals.customers.revenue.to_string() == revenue;
+  std::cout << filename << " with \"" << journal_text.substr(0, journal_text.find('\n')) << "\": "
+            << (scanned ? "" : "scan failed, ") << totals.customers.purchases << " purchases, $"
+            << totals.customers.revenue.to_string() << (ok ? "" : "  FAIL") << std::endl;
+  return ok;
+}
+
+int main()
+{
+  char directory[] = "/tmp/db_test.XXXXXX";
+  if (mkdtemp(directory) == nullptr)
+  {
+    std::cout << "FAIL: no temporary directory" << std::endl;
+    return 1;
+  }
+  std::string text = std::string(directory) + "/db.dat", binary = std::string(directory) + "/db.cdb";
+  write_file(text, snapshot);
+  Company_DB db;
+  bool ok = db.load(text) and db.save(binary, BINARY_DB);
+
+  for (const std::string &filename : {text, binary})
+  {
+    // a journal which follows the snapshot is merged; a stale one (whose
+    // records the snapshot already has) is skipped without failing
+    ok = check(filename, journal("journal 0 1 2"), 3, "33") and ok;
+    ok = check(filename, journal("journal 0 1 1"), 2, "13") and ok;
+    ok = check(filename, journal("journal 0 0 2"), 2, "13") and ok;
+  }
+
+  std::remove(text.c_str());
+  std::remove(binary.c_str());
+  std::remove((binary + ".prev").c_str());
+  rmdir(directory);
+
+  if (ok)
+  {
+    std::cout << "PASS" << std::endl;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+// File: decimal.cpp
+// Purpose: Implementation of fixed point decimal numbers.
+#include "decimal.h"
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+
+// the decimal with the given number of millionths
+Decimal Decimal::from_units(long long units)
+{
+  Decimal result;
+  result._units = units;
+  return result;
+}
+
+// convert a whole number, false if it is out of range
+bool Decimal::from_integer(long long value, Decimal &result)
+{
+  return not __builtin_mul_overflow(value, scale, &result._units);
+}
+
+// convert a real, rounded to the nearest millionth
+bool Decimal::from_real(double value, Decimal &result)
+{
+  double units = std::round(value * scale);
+  if (not (units > -9.2e18 and units < 9.2e18))
+  {
+    return false;
+  }
+  result._units = (long long)units;
+  return true;
+}
+
+// parse [-]digits[.digits] with at most six decimal places
+bool Decimal::parse(std::string_view text, Decimal &result)
+{
+  bool negative = false;
+  if (not text.empty() and (text[0] == '-' or text[0] == '+'))
+  {
+    negative = text[0] == '-';
+    text.remove_prefix(1);
+  }
+
+  long long units = 0;
+  int digits = 0, places = -1;
+  for (char c : text)
+  {
+    if (c == '.' and places < 0)
+    {
+      places = 0;
+    }
+    else if (c >= '0' and c <= '9' and places < Decimal::places)
+    {
+      if (__builtin_mul_overflow(units, 10, &units) or __builtin_add_overflow(units, c - '0', &units))
+      {
+        return false;
+      }
+      digits++;
+      if (places >= 0)
+      {
+        places++;
+      }
+    }
+    else
+    {
+      return false;
+    }
+  }
+  if (digits == 0)
+  {
+    return false;
+  }
+
+  // scale up the places which were not given
+  for (int i = places < 0 ? 0 : places; i < Decimal::places; i++)
+  {
+    if (__builtin_mul_overflow(units, 10, &units))
+    {
+      return false;
+    }
+  }
+  result._units = negative ? -units : units;
+  return true;
+}
+
+// the number of millionths
+long long Decimal::units() const
+{
+  return _units;
+}
+
+// true if there is no fractional part
+bool Decimal::whole() const
+{
+  return _units % scale == 0;
+}
+
+// the value truncated to a whole number
+long long Decimal::to_integer() const
+{
+  return _units / scale;
+}
+
+// the value as a real
+double Decimal::to_real() const
+{
+  return (double)_units / scale;
+}
+
+// the value with all six places
+std::string Decimal::to_fixed() const
+{
+  char buffer[32];
+  return std::string(buffer, format(buffer, false));
+}
+
+// the value with trailing zeros dropped
+std::string Decimal::to_string() const
+{
+  char buffer[32];
+  return std::string(buffer, format(buffer, true));
+}
+
+bool Decimal::add(Decimal a, Decimal b, Decimal &result)
+{
+  return not __builtin_add_overflow(a._units, b._units, &result._units);
+}
+
+bool Decimal::subtract(Decimal a, Decimal b, Decimal &result)
+{
+  return not __builtin_sub_overflow(a._units, b._units, &result._units);
+}
+
+bool Decimal::multiply(Decimal a, Decimal b, Decimal &result)
+{
+  // the product has twelve places, round it back to six
+  __int128 product = (__int128)a._units * b._units;
+  __int128 half = product < 0 ? -scale / 2 : scale / 2;
+  __int128 units = (product + half) / scale;
+  if (units < INT64_MIN or units > INT64_MAX)
+  {
+    return false;
+  }
+  result._units = (long long)units;
+  return true;
+}
+
+bool Decimal::divide(Decimal a, Decimal b, Decimal &result)
+{
+  if (b._units == 0)
+  {
+    return false;
+  }
+
+  // scale the dividend so the quotient has six places, then round it
+  __int128 n = (__int128)a._units * scale;
+  __int128 units = n / b._units;
+  __int128 remainder = n % b._units;
+  if (remainder != 0)
+  {
+    __int128 twice = remainder < 0 ? -2 * remainder : 2 * remainder;
+    __int128 divisor = b._units < 0 ? -(__int128)b._units : b._units;
+    if (twice >= divisor)
+    {
+      units += (n < 0) != (b._units < 0) ? -1 : 1;
+    }
+  }
+  if (units < INT64_MIN or units > INT64_MAX)
+  {
+    return false;
+  }
+  result._units = (long long)units;
+  return true;
+}
+
+// -1, 0 or 1 as a is less than, equal to or greater than b
+int Decimal::compare(Decimal a, Decimal b)
+{
+  return a._units < b._units ? -1 : a._units > b._units ? 1 : 0;
+}
+
+// write the digits into buffer, returning the length
+int Decimal::format(char *buffer, bool trim) const
+{
+  char *p = buffer;
+  unsigned long long magnitude = _units < 0 ? 0ull - (unsigned long long)_units : _units;
+  if (_units < 0)
+  {
+    *p++ = '-';
+  }
+  p = std::to_chars(p, buffer + 24, magnitude / scale).ptr;
+
+  // the six places, from the right
+  unsigned long long fraction = magnitude % scale;
+  if (trim and fraction == 0)
+  {
+    return p - buffer;
+  }
+  *p++ = '.';
+  for (int i = places - 1; i >= 0; i--)
+  {
+    p[i] = '0' + fraction % 10;
+    fraction /= 10;
+  }
+  p += places;
+  if (trim)
+  {
+    while (p[-1] == '0')
+    {
+      p--;
+    }
+  }
+  return p - buffer;
+}
@@ -0,0 +1,60 @@
+// File: decimal.h
+// Purpose: Fixed point decimal numbers, for amounts of money.
+#ifndef DECIMAL_H
+#define DECIMAL_H
+#include <string>
+#include <string_view>
+
+// A decimal is a 64 bit count of millionths, so it holds six decimal places
+// exactly (the precision the company DB files are written with). The
+// arithmetic functions round to the nearest millionth, halves away from
+// zero, and return false instead of overflowing.
+class Decimal
+{
+public:
+  static const int places = 6;
+  static const long long scale = 1000000;
+
+  Decimal() : _units(0) {}
+
+  // the decimal with the given number of millionths
+  static Decimal from_units(long long units);
+
+  // convert a whole number or a real, false if it is out of range
+  static bool from_integer(long long value, Decimal &result);
+  static bool from_real(double value, Decimal &result);
+
+  // parse [-]digits[.digits] with at most six decimal places, false if invalid
+  static bool parse(std::string_view text, Decimal &result);
+
+  // the number of millionths
+  long long units() const;
+
+  // true if there is no fractional part
+  bool whole() const;
+
+  // the value truncated to a whole number, or as a real
+  long long to_integer() const;
+  double to_real() const;
+
+  // the value with all six places (as the DB files store it), or with
+  // trailing zeros dropped (for display)
+  std::string to_fixed() const;
+  std::string to_string() const;
+
+  static bool add(Decimal a, Decimal b, Decimal &result);
+  static bool subtract(Decimal a, Decimal b, Decimal &result);
+  static bool multiply(Decimal a, Decimal b, Decimal &result);
+  static bool divide(Decimal a, Decimal b, Decimal &result);
+
+  // -1, 0 or 1 as a is less than, equal to or greater than b
+  static int compare(Decimal a, Decimal b);
+
+private:
+  long long _units;
+
+  // write the digits into buffer (at least 28 chars), returning the length
+  int format(char *buffer, bool trim) const;
+};
+
+#endif
@@ -1,9 +1,10 @@
 // File: lexer.cpp
 // Purpose: Implementation for a lexer.
 #include "lexer.h"
+#include <array>
 #include <ctype.h>
 #include <iostream>
-#include <map>
+#include <iterator>
 #include <string>
 
 ////////////////////////////////////////
@@ -13,7 +14,7 @@ Lexer_Token::Lexer_Token() {
   // do nothing
 }
 
-Lexer_Token::Lexer_Token(Token tok, const std::string &lexeme, int line,
+Lexer_Token::Lexer_Token(Token tok, std::string_view lexeme, int line,
                          int col) {
   this->tok = tok;
   this->lexeme = lexeme;
@@ -32,21 +33,155 @@ std::ostream &operator<<(std::ostream &os, const Lexer_Token &t) {
   "WITH",
   "BOUNDS","SET","GET", "SIZE", "UPDATE", "LOAD", "FETCH", "EMPLOYEE",
   "CUSTOMER",
-  "CUSTOMER_PURCHASE", "WRITE", "CLOSE", "OBJECT", "OBJ", "PRIVATE", "PUBLIC"};
+  "CUSTOMER_PURCHASE", "WRITE", "CLOSE", "REPORT", "OBJECT", "OBJ", "PRIVATE", "PUBLIC"};
   return os << token_label[t.tok] << " \"" << t.lexeme << "\" Line: " << t.line
             << " Column " << t.col;
 }
 
+////////////////////////////////////////
+// Token tables (built at compile time)
+////////////////////////////////////////
+namespace {
+
+// tokens made of a single character, indexed by the character
+constexpr std::array<Token, 256> make_single_tokens() {
+  std::array<Token, 256> tokens{};   // everything else is INVALID
+  tokens['\n'] = NEWLINE;
+  tokens['+'] = PLUS;
+  tokens['-'] = MINUS;
+  tokens['*'] = TIMES;
+  tokens['/'] = DIVIDE;
+  tokens['^'] = POW;
+  tokens['('] = LPAREN;
+  tokens[')'] = RPAREN;
+  tokens['='] = EQUAL;
+  tokens['.'] = DOT;
+  tokens[','] = COMMA;
+  tokens['['] = LBRACKET;
+  tokens[']'] = RBRACKET;
+  return tokens;
+}
+constexpr std::array<Token, 256> single_tokens = make_single_tokens();
+
+struct Keyword {
+  std::string_view text;
+  Token tok;
+};
+
+constexpr Keyword keywords[] = {
+  {"MOD", MOD},
+  {"display", DISPLAY},
+  {"input", INPUT},
+  {"new", NEW},
+  {"record", RECORD},
+  {"end", END},
+  {"field", FIELD},
+  {"if", IF},
+  {"while", WHILE},
+  {"fun", FUN},
+  {"class", CLASS},
+  {"array", ARRAY},
+  {"of", OF},
+  {"with", WITH},
+  {"bound", BOUNDS},
+  {"set", SET},
+  {"get", GET},
+  {"size", SIZE},
+  {"update", UPDATE},
+  {"load", LOAD},
+  {"fetch", FETCH},
+  {"employee", EMPLOYEE},
+  {"customer", CUSTOMER},
+  {"customer_purchase", CUSTOMER_PURCHASE},
+  {"write", WRITE},
+  {"close", CLOSE},
+  {"report", REPORT},
+  {"inherits", INHERITS},
+  {"Object", OBJECT},
+  {"obj", OBJ},
+  {"private", PRIVATE},
+  {"public", PUBLIC},
+};
+
+// FNV-1a with a seed chosen so that no two keywords share a slot.
+// If a keyword is added and the static_assert below fires, pick a new seed.
+constexpr int KEYWORD_BITS = 6;
+constexpr unsigned KEYWORD_SEED = 6619;
+
+constexpr unsigned keyword_hash(std::string_view text) {
+  unsigned h = KEYWORD_SEED;
+  for (char c : text) {
+    h = (h ^ (unsigned char)c) * 16777619u;
+  }
+  return h >> (32 - KEYWORD_BITS);
+}
+
+// the keyword table, indexed by keyword_hash
+struct Keyword_Table {
+  Keyword slots[1 << KEYWORD_BITS];
+  bool perfect;
+};
+
+constexpr Keyword_Table make_keyword_table() {
+  Keyword_Table table{};
+  table.perfect = true;
+  for (const Keyword &kw : keywords) {
+    Keyword &slot = table.slots[keyword_hash(kw.text)];
+    if (not slot.text.empty()) {
+      table.perfect = false;
+    }
+    slot = kw;
+  }
+  return table;
+}
+constexpr Keyword_Table keyword_table = make_keyword_table();
+static_assert(keyword_table.perfect, "keyword hash collision, change KEYWORD_SEED");
+
+// the keyword token for text, or ID
+constexpr Token keyword(std::string_view text) {
+  const Keyword &slot = keyword_table.slots[keyword_hash(text)];
+  return slot.text == text ? slot.tok : ID;
+}
+static_assert(keyword("customer_purchase") == CUSTOMER_PURCHASE);
+static_assert(keyword("customers") == ID);
+
+}
+
 ////////////////////////////////////////
 // Lexer Implementation
 ////////////////////////////////////////
-Lexer::Lexer(std::istream &_is) : _is(_is) {
+Lexer::Lexer(std::istream &is) {
+  // read the whole stream up front and lex it from memory
+  _buffer.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+  start(_buffer);
+  _intern = true;
+}
+
+Lexer::Lexer(std::string_view source) {
+  start(source);
+  _intern = false;
+}
+
+// start lexing a buffer
+void Lexer::start(std::string_view source) {
+  _arena = &_own_arena;
   _cur.tok = INVALID;
+  _cur_char = '\0';
   _line = 1;
   _col = 0;
+  _end = source.data() + source.size();
 
   // read the first character
-  read();
+  _cur_ptr = source.data();
+  if (_cur_ptr != _end) {
+    _cur_char = *_cur_ptr;
+    _col++;
+  }
+}
+
+// intern lexemes into arena (e.g. the parser's) instead of our own
+void Lexer::arena(Arena *_arena) {
+  this->_arena = _arena;
 }
 
 // return the next token in the stream
@@ -55,19 +190,22 @@ Lexer_Token Lexer::next() {
   skip();
 
   // handle end of file
-  if(not _is) {
+  if(at_end()) {
     _cur = Lexer_Token(EOI, "", _line, _col);
     return _cur;
   }
   
   // initialize the next token
   _cur = Lexer_Token(INVALID, "", _line, _col);
+  _start = _cur_ptr;
+  bool quoted = false;
 
   if (lex_single()) {
     // nothing to do
   }
   else if(lex_string())
   {
+    quoted = true;
   } else if (lex_number()) {
     // nothing to do
   } else if(lex_fixed()) {
@@ -79,12 +217,26 @@ Lexer_Token Lexer::next() {
     consume();
   }
 
+  std::string_view lexeme = text();
+  if(quoted) {
+    // drop the quotes
+    lexeme = lexeme.substr(1, lexeme.size() - 2);
+  }
+  _cur.lexeme = _intern ? _arena->intern(lexeme) : lexeme;
   return _cur;
 }
 
 // return the current token
 Lexer_Token Lexer::cur() { return _cur; }
 
+// true once every character has been read
+bool Lexer::at_end() const { return _cur_ptr == _end; }
+
+// the text matched so far
+std::string_view Lexer::text() const {
+  return std::string_view(_start, _cur_ptr - _start);
+}
+
 // get the next character from the stream
 void Lexer::read() {
   // handle the start of new lines
@@ -94,28 +246,32 @@ void Lexer::read() {
   }
 
   // read a character
-  _cur_char = _is.get();
-  if (_is) {
+  if (_cur_ptr != _end) {
+    _cur_ptr++;
+  }
+  if (_cur_ptr != _end) {
+    _cur_char = *_cur_ptr;
     // increment the column if we have read the character
     _col++;
+  } else {
+    _cur_char = '\0';
   }
 }
 
 // consume a character after it is matched
 void Lexer::consume() {
-  _cur.lexeme += _cur_char;
   read();
 }
 
 // skip insignificant / non-token input
 void Lexer::skip() {
-  while(_is && _cur_char != '\n' && isspace(_cur_char)) {
+  while(not at_end() && _cur_char != '\n' && isspace(_cur_char)) {
     read();
   }
 
   // skip comments
   if(_cur_char == '#') {
-    while(_is && _cur_char != '\n') {
+    while(not at_end() && _cur_char != '\n') {
       read();
     }
   }
@@ -123,32 +279,16 @@ void Lexer::skip() {
 
 // attempt to match a single character token, return true on success
 bool Lexer::lex_single() {
-  // build our map of tokens
-  std::map<char, Token> tokens;
-  tokens['\n'] = NEWLINE;
-  tokens['+'] = PLUS;
-  tokens['-'] = MINUS;
-  tokens['*'] = TIMES;
-  tokens['/'] = DIVIDE;
-  tokens['^'] = POW;
-  tokens['('] = LPAREN;
-  tokens[')'] = RPAREN;
-  tokens['='] = EQUAL;
-  tokens['.'] = DOT;
-  tokens[','] = COMMA;
-  tokens['['] = LBRACKET;
-  tokens[']'] = RBRACKET;
-
-  // search for the current character in our map
-  auto itr = tokens.find(_cur_char);
-  if (itr == tokens.end()) {
+  // search for the current character in our table
+  Token tok = single_tokens[(unsigned char)_cur_char];
+  if (tok == INVALID) {
     // no match
     return false;
   }
 
   // we have matched a token
   consume();
-  _cur.tok = itr->second;
+  _cur.tok = tok;
 
   return true;
 }
@@ -196,51 +336,13 @@ bool Lexer::lex_number() {
 
 // attempt to match a keyword or an id
 bool Lexer::lex_kw_or_id() {
-  std::map<std::string, Token> tokens;
-  tokens["MOD"] = MOD;
-  tokens["display"] = DISPLAY;
-  tokens["input"] = INPUT;
-  tokens["new"] = NEW;
-  tokens["record"] = RECORD;
-  tokens["end"] = END;
-  tokens["field"] = FIELD;
-  tokens["if"] = IF;
-  tokens["while"] = WHILE;
-  tokens["fun"] = FUN;
-  tokens["class"] = CLASS;
-  tokens["array"] = ARRAY;
-  tokens["of"] = OF;
-  tokens["with"] = WITH;
-  tokens["bound"] = BOUNDS;
-  tokens["set"] = SET;
-  tokens["get"] = GET;
-  tokens["size"] = SIZE;
-  tokens["update"] = UPDATE;
-  tokens["load"] = LOAD;
-  tokens["fetch"] = FETCH;
-  tokens["employee"] = EMPLOYEE;
-  tokens["customer"] = CUSTOMER;
-  tokens["customer_purchase"] = CUSTOMER_PURCHASE;
-  tokens["write"] = WRITE;
-  tokens["close"] = CLOSE;
-  tokens["inherits"] = INHERITS;
-  tokens["Object"] = OBJECT;
-  tokens["obj"] = OBJ;
-  tokens["private"] = PRIVATE;
-  tokens["public"] = PUBLIC;
-
   // check to see if it starts properly
   if(_cur_char != '_' and not isalpha(_cur_char)){return false;}
 
   // consume all of the alpha numeric characters and _s
   while(isalnum(_cur_char) or _cur_char == '_') { consume(); }
 
-  auto itr = tokens.find(_cur.lexeme);
-  if(itr != tokens.end()) {
-    _cur.tok = itr->second;
-  } else {
-    _cur.tok = ID; 
-  }
+  _cur.tok = keyword(text());
 
   return true;
 }
@@ -266,7 +368,6 @@ bool Lexer::lex_string()
   {
     consume();
   }
-  _cur.lexeme = _cur.lexeme.substr(1, _cur.lexeme.size() - 2);
 
   return true;
 }
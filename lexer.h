@@ -3,7 +3,9 @@
 #ifndef LEXER_H
 #define LEXER_H
 #include <string>
+#include <string_view>
 #include <iostream>
+#include "arena.h"
 
 // our language's tokens
 enum Token {
@@ -57,6 +59,7 @@ enum Token {
   CUSTOMER_PURCHASE,
   WRITE,
   CLOSE,
+  REPORT,
   INHERITS,
   OBJECT,
   OBJ,
@@ -69,9 +72,9 @@ class Lexer_Token
 {
 public:
   Lexer_Token();
-  Lexer_Token(Token tok, const std::string &lexeme, int line, int col);
+  Lexer_Token(Token tok, std::string_view lexeme, int line, int col);
   Token tok;
-  std::string lexeme;
+  std::string_view lexeme;  // view of the source, or of the lexer's arena
   int line;
   int col;
 };
@@ -81,7 +84,14 @@ std::ostream &operator<<(std::ostream &os, const Lexer_Token &t);
 class Lexer
 {
 public:
-  Lexer(std::istream &_is);
+  // lex a stream (e.g. a REPL line), lexemes are copied into the arena
+  Lexer(std::istream &is);
+
+  // lex a buffer in place, lexemes are views of it so it must outlive them
+  Lexer(std::string_view source);
+
+  // intern lexemes into arena (e.g. the parser's) instead of our own
+  void arena(Arena *_arena);
 
   //return the next token in the stream
   Lexer_Token next();
@@ -90,12 +100,27 @@ public:
   Lexer_Token cur();
 
 private:
-  std::istream &_is;
+  std::string _buffer;   // the contents of a stream
+  const char *_cur_ptr;  // where _cur_char came from
+  const char *_end;
+  const char *_start;    // the start of the lexeme being matched
   char _cur_char;
   Lexer_Token _cur;
+  bool _intern;          // lexemes must outlive the buffer
+  Arena _own_arena;
+  Arena *_arena;
   int _line;
   int _col;
 
+  // start lexing a buffer
+  void start(std::string_view source);
+
+  // true once every character has been read
+  bool at_end() const;
+
+  // the text matched so far
+  std::string_view text() const;
+
   // get the next character from the stream
   void read();
 
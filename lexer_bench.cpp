@@ -0,0 +1,70 @@
+// File: lexer_bench.cpp
+// Purpose: Measure lexer throughput on a large generated script, or on the
+//          file named on the command line.
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "lexer.h"
+
+// a chunk of typical calc code, repeated to make a large script
+static const char *sample =
+  "fun fib(n)\n"
+  "  if n < 2\n"
+  "    result = n\n"
+  "  end if\n"
+  "  if n >= 2\n"
+  "    result = fib(n - 1) + fib(n - 2)\n"
+  "  end if\n"
+  "  result\n"
+  "end fun\n"
+  "array int of numbers with bound 10\n"
+  "set numbers[i] = total * 2.5 ^ 3 MOD 7\n"
+  "while counter <> limit # count up\n"
+  "  counter = counter + 1\n"
+  "  display \"counter is\" counter\n"
+  "end while\n"
+  "load customer_purchase from customers with customer_number\n";
+
+// lex all of text and report the rate, either through a stream (as the
+// REPL does) or in place (as calc_run does)
+static void time_lexer(const std::string &text, bool in_place)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  std::istringstream is(text);
+  Lexer lex = in_place ? Lexer(text) : Lexer(is);
+  long tokens = 0;
+  while (lex.next().tok != EOI) {
+    tokens++;
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << (in_place ? "buffer: " : "stream: ") << tokens << " tokens, "
+            << text.size() << " bytes in "
+            << elapsed.count() << "s (" << (long)(tokens / elapsed.count())
+            << " tokens/s)" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  std::string text;
+  if (argc > 1) {
+    std::ifstream file(argv[1]);
+    if (!file) {
+      std::cerr << "Could not open file: " << argv[1] << std::endl;
+      return 1;
+    }
+    std::ostringstream os;
+    os << file.rdbuf();
+    text = os.str();
+  } else {
+    for (int i = 0; i < 50000; i++) {
+      text += sample;
+    }
+  }
+
+  time_lexer(text, false);
+  time_lexer(text, true);
+}
@@ -0,0 +1,69 @@
+// File: mapped_file.cpp
+// Purpose: Implementation of the memory mapped file reader.
+#include "mapped_file.h"
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Mapped_File::Mapped_File(const std::string &filename)
+{
+  _data = nullptr;
+  _size = 0;
+  _mapped = false;
+  _ok = false;
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0)
+  {
+    struct stat st;
+    if (fstat(fd, &st) == 0 and S_ISREG(st.st_mode) and st.st_size > 0)
+    {
+      void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED)
+      {
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+        _data = (const char *)p;
+        _size = st.st_size;
+        _mapped = true;
+        _ok = true;
+      }
+    }
+    close(fd);
+  }
+
+  if (not _mapped)
+  {
+    // empty files, pipes and the like are read the ordinary way
+    std::ifstream file(filename, std::ios::binary);
+    if (file)
+    {
+      _copy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      _data = _copy.data();
+      _size = _copy.size();
+      _ok = true;
+    }
+  }
+}
+
+Mapped_File::~Mapped_File()
+{
+  if (_mapped)
+  {
+    munmap((void *)_data, _size);
+  }
+}
+
+// true if the file was opened
+bool Mapped_File::ok() const
+{
+  return _ok;
+}
+
+// the contents of the file, valid as long as this object
+std::string_view Mapped_File::text() const
+{
+  return std::string_view(_data, _size);
+}
@@ -0,0 +1,33 @@
+// File: mapped_file.h
+// Purpose: Read-only view of a whole file, memory mapped where possible.
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <string>
+#include <string_view>
+
+class Mapped_File
+{
+public:
+  // map the file, check ok() to see if it could be opened
+  Mapped_File(const std::string &filename);
+  ~Mapped_File();
+
+  // true if the file was opened
+  bool ok() const;
+
+  // the contents of the file, valid as long as this object
+  std::string_view text() const;
+
+private:
+  const char *_data;
+  size_t _size;
+  bool _mapped;          // _data is a mapping rather than _copy
+  bool _ok;
+  std::string _copy;     // contents of files which cannot be mapped
+
+  // files are released on destruction, so they cannot be copied
+  Mapped_File(const Mapped_File &) = delete;
+  Mapped_File &operator=(const Mapped_File &) = delete;
+};
+
+#endif
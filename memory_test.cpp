@@ -0,0 +1,102 @@
+// File: memory_test.cpp
+// Purpose: Check that function calls run in flat memory: a million calls
+//          should leave the resident set no bigger than a hundred thousand.
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "lexer.h"
+#include "parser.h"
+#include "ref_env.h"
+#include "scope.h"
+#include "vm.h"
+
+// each iteration makes three calls, one of them to a nested function
+static const char *program =
+  "fun step(x)\n"
+  "  y = x + 1\n"
+  "  y\n"
+  "end fun\n"
+  "fun nested(x)\n"
+  "  fun inner()\n"
+  "    x + 1\n"
+  "  end fun\n"
+  "  inner()\n"
+  "end fun\n"
+  "i = 0\n"
+  "while i < calls\n"
+  "  i = step(i)\n"
+  "  j = nested(i)\n"
+  "end while\n";
+
+// the resident set size in bytes
+static long rss()
+{
+  long pages = 0, resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm != nullptr)
+  {
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+    {
+      resident = 0;
+    }
+    fclose(statm);
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+// run the program for some number of iterations, returning the RSS after
+static long run(int calls, bool tree_walk)
+{
+  Lexer lexer(program);
+  Parser parser(&lexer);
+  Parse_Tree *tree = parser.parse();
+
+  Ref_Env env;
+  EvalResult limit;
+  limit.set(calls);
+  env.set("calls", limit);
+  resolve(tree, env.scope());
+
+  if (tree_walk)
+  {
+    tree->eval(&env);
+  }
+  else
+  {
+    Compiler compiler;
+    Chunk *chunk = compiler.compile(tree);
+    VM vm;
+    vm.run(chunk, &env);
+    delete chunk;
+  }
+
+  return rss();
+}
+
+int main()
+{
+  const long allowed = 1024 * 1024;
+  bool ok = true;
+
+  for (bool tree_walk : {true, false})
+  {
+    long before = run(100000, tree_walk);
+    long after = run(1000000, tree_walk);
+    long growth = after - before;
+
+    std::cout << (tree_walk ? "tree: " : "vm:   ") << before / 1024 << "KB after 100000 iterations, "
+              << after / 1024 << "KB after 1000000" << std::endl;
+    if (growth > allowed)
+    {
+      std::cout << "FAIL: grew by " << growth / 1024 << "KB" << std::endl;
+      ok = false;
+    }
+  }
+
+  if (ok)
+  {
+    std::cout << "PASS" << std::endl;
+  }
+  return ok ? 0 : 1;
+}
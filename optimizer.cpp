@@ -0,0 +1,353 @@
+// File: optimizer.cpp
+// Purpose: The optimization pass (calc -O), run between parsing and
+//          evaluation. It folds constant subtrees, removes identity
+//          operations and strength reduces powers.
+//
+// Every rewrite must give exactly the value the evaluator would have, with
+// the same int/real coercions. Variables may hold a value of any type at
+// run time, so identities like x * 1 are only removed when the type of x is
+// known from the tree (e.g. x is itself an integer expression).
+#include <exception>
+#include "parse_tree.h"
+
+// optimize a whole program, returning the tree to run
+Parse_Tree *optimize(Parse_Tree *program, Arena &arena)
+{
+  return program->optimize(arena);
+}
+
+//////////////////////////////////////////
+// Helpers
+//////////////////////////////////////////
+
+// the type a node always evaluates to, or UNDEFINED if it is not known
+static EvalType type_of(Parse_Tree *node)
+{
+  // (big integers count as integers, since any integer result may be big)
+  if (Constant *c = dynamic_cast<Constant *>(node))
+  {
+    return c->value().type() == BIGINT ? INTEGER : c->value().type();
+  }
+
+  // the arithmetic operators give a real if either side is real, else an
+  // integer (Add also joins strings)
+  BinaryOp *op = dynamic_cast<BinaryOp *>(node);
+  if (dynamic_cast<Add *>(node) or dynamic_cast<Subtract *>(node) or
+      dynamic_cast<Multiply *>(node) or dynamic_cast<Divide *>(node))
+  {
+    EvalType l = type_of(op->left());
+    EvalType r = type_of(op->right());
+    if (l == REAL or r == REAL)
+    {
+      return REAL;
+    }
+    if (l == UNDEFINED or r == UNDEFINED or l == DECIMAL or r == DECIMAL)
+    {
+      return UNDEFINED;
+    }
+    if (dynamic_cast<Add *>(node) and l == STRING and r == STRING)
+    {
+      return STRING;
+    }
+    return INTEGER;
+  }
+
+  if (dynamic_cast<Mod *>(node))
+  {
+    return INTEGER;
+  }
+
+  // integer powers are integers unless they overflow
+  if (Power *power = dynamic_cast<Power *>(node))
+  {
+    if (type_of(power->left()) == REAL or type_of(power->right()) == REAL)
+    {
+      return REAL;
+    }
+    return UNDEFINED;
+  }
+  if (Square *square = dynamic_cast<Square *>(node))
+  {
+    return type_of(square->child()) == REAL ? REAL : UNDEFINED;
+  }
+
+  if (Negation *neg = dynamic_cast<Negation *>(node))
+  {
+    EvalType c = type_of(neg->child());
+    if (c == UNDEFINED or c == DECIMAL)
+    {
+      return UNDEFINED;
+    }
+    return c == REAL ? REAL : INTEGER;
+  }
+
+  if (dynamic_cast<Equal *>(node) or dynamic_cast<Not_Equal *>(node) or
+      dynamic_cast<Less *>(node) or dynamic_cast<Greater *>(node) or
+      dynamic_cast<Less_or_Equal *>(node) or dynamic_cast<Greater_or_Equal *>(node))
+  {
+    return BOOLEAN;
+  }
+
+  return UNDEFINED;
+}
+
+// true if node is a known integer or real
+static bool numeric(Parse_Tree *node)
+{
+  EvalType type = type_of(node);
+  return type == INTEGER or type == REAL;
+}
+
+// true if node is the integer constant value
+static bool is_integer(Parse_Tree *node, int value)
+{
+  Constant *c = dynamic_cast<Constant *>(node);
+  return c and c->value().type() == INTEGER and c->value().as_integer() == value;
+}
+
+// true if node is the real constant value
+static bool is_real(Parse_Tree *node, double value)
+{
+  Constant *c = dynamic_cast<Constant *>(node);
+  return c and c->value().type() == REAL and c->value().as_real() == value;
+}
+
+// replace op by its value if both of its operands are constants
+template <typename Op>
+static Parse_Tree *fold(Op *op, Arena &arena)
+{
+  Constant *l = dynamic_cast<Constant *>(op->left());
+  Constant *r = dynamic_cast<Constant *>(op->right());
+  if (l and r)
+  {
+    return new (arena) Constant(Op::apply(l->value(), r->value()));
+  }
+  return op;
+}
+
+// true if integer division of the constants is by zero, in which case it
+// is left for run time
+static bool traps(Parse_Tree *left, Parse_Tree *right)
+{
+  Constant *l = dynamic_cast<Constant *>(left);
+  Constant *r = dynamic_cast<Constant *>(right);
+  if (not l or not r or l->value().type() == REAL or r->value().type() == REAL)
+  {
+    return false;
+  }
+  return r->value().as_integer() == 0;
+}
+
+//////////////////////////////////////////
+// Base classes for the operators
+//////////////////////////////////////////
+Parse_Tree *Parse_Tree::optimize(Arena &arena)
+{
+  // nothing to simplify
+  return this;
+}
+
+Parse_Tree *UnaryOp::optimize(Arena &arena)
+{
+  child(child()->optimize(arena));
+  return this;
+}
+
+Parse_Tree *BinaryOp::optimize(Arena &arena)
+{
+  left(left()->optimize(arena));
+  right(right()->optimize(arena));
+  return this;
+}
+
+Parse_Tree *NaryOp::optimize(Arena &arena)
+{
+  for (Parse_Tree *&child : _children)
+  {
+    child = child->optimize(arena);
+  }
+  return this;
+}
+
+//////////////////////////////////////////
+// Operator Nodes
+//////////////////////////////////////////
+Parse_Tree *Literal::optimize(Arena &arena)
+{
+  // parse the literal once, rather than every time it is evaluated (a
+  // literal which does not parse is left to fail if it is reached)
+  try
+  {
+    return new (arena) Constant(eval(nullptr));
+  }
+  catch (std::exception &e)
+  {
+    return this;
+  }
+}
+
+Parse_Tree *Add::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  if (Parse_Tree *folded = fold(this, arena); folded != this)
+  {
+    return folded;
+  }
+
+  // x + 0 and 0 + x (integers only: -0.0 + 0 is 0.0)
+  if (is_integer(right(), 0) and type_of(left()) == INTEGER)
+  {
+    return left();
+  }
+  if (is_integer(left(), 0) and type_of(right()) == INTEGER)
+  {
+    return right();
+  }
+  return this;
+}
+
+Parse_Tree *Subtract::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  if (Parse_Tree *folded = fold(this, arena); folded != this)
+  {
+    return folded;
+  }
+
+  // x - 0
+  if (is_integer(right(), 0) and numeric(left()))
+  {
+    return left();
+  }
+  return this;
+}
+
+Parse_Tree *Multiply::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  if (Parse_Tree *folded = fold(this, arena); folded != this)
+  {
+    return folded;
+  }
+
+  // x * 1 and 1 * x (and 1.0 when x is already real)
+  if ((is_integer(right(), 1) and numeric(left())) or
+      (is_real(right(), 1) and type_of(left()) == REAL))
+  {
+    return left();
+  }
+  if ((is_integer(left(), 1) and numeric(right())) or
+      (is_real(left(), 1) and type_of(right()) == REAL))
+  {
+    return right();
+  }
+  return this;
+}
+
+Parse_Tree *Divide::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  if (not traps(left(), right()))
+  {
+    if (Parse_Tree *folded = fold(this, arena); folded != this)
+    {
+      return folded;
+    }
+  }
+
+  // x / 1 (and 1.0 when x is already real)
+  if ((is_integer(right(), 1) and numeric(left())) or
+      (is_real(right(), 1) and type_of(left()) == REAL))
+  {
+    return left();
+  }
+  return this;
+}
+
+Parse_Tree *Mod::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  if (traps(left(), right()))
+  {
+    return this;
+  }
+  return fold(this, arena);
+}
+
+Parse_Tree *Power::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  if (Parse_Tree *folded = fold(this, arena); folded != this)
+  {
+    return folded;
+  }
+
+  // x ^ 2 is x * x, which pow() agrees with exactly (it does not for
+  // higher powers, so those are left alone)
+  if (is_integer(right(), 2) or is_real(right(), 2))
+  {
+    Square *square = new (arena) Square();
+    square->child(left());
+    return square;
+  }
+
+  // x ^ 1 is x when x is already real
+  if ((is_integer(right(), 1) or is_real(right(), 1)) and type_of(left()) == REAL)
+  {
+    return left();
+  }
+  return this;
+}
+
+Parse_Tree *Negation::optimize(Arena &arena)
+{
+  UnaryOp::optimize(arena);
+  if (Constant *c = dynamic_cast<Constant *>(child()))
+  {
+    return new (arena) Constant(apply(c->value()));
+  }
+
+  // - - x
+  Negation *inner = dynamic_cast<Negation *>(child());
+  if (inner and numeric(inner->child()))
+  {
+    return inner->child();
+  }
+  return this;
+}
+
+Parse_Tree *Equal::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  return fold(this, arena);
+}
+
+Parse_Tree *Not_Equal::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  return fold(this, arena);
+}
+
+Parse_Tree *Greater::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  return fold(this, arena);
+}
+
+Parse_Tree *Less::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  return fold(this, arena);
+}
+
+Parse_Tree *Less_or_Equal::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  return fold(this, arena);
+}
+
+Parse_Tree *Greater_or_Equal::optimize(Arena &arena)
+{
+  BinaryOp::optimize(arena);
+  return fold(this, arena);
+}
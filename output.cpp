@@ -0,0 +1,100 @@
+// File: output.cpp
+// Purpose: Implementation of the buffered output sink.
+#include "output.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+// size of the buffer
+static const size_t buffer_size = 1 << 16;
+
+Output::Output(bool buffered)
+{
+  if (buffered)
+  {
+    _buffer.resize(buffer_size);
+    setp(_buffer.data(), _buffer.data() + _buffer.size());
+  }
+  _previous = std::cout.rdbuf(this);
+}
+
+Output::~Output()
+{
+  flush();
+  std::cout.rdbuf(_previous);
+}
+
+// write out everything collected so far
+bool Output::flush()
+{
+  bool ok = write(pbase(), pptr() - pbase());
+  setp(pbase(), epptr());
+  return ok;
+}
+
+// the buffer is full (or there is none), make room for c
+Output::int_type Output::overflow(int_type c)
+{
+  if (not flush())
+  {
+    return traits_type::eof();
+  }
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    return traits_type::not_eof(c);
+  }
+  if (pptr() == epptr())
+  {
+    char ch = traits_type::to_char_type(c);
+    return write(&ch, 1) ? c : traits_type::eof();
+  }
+  return sputc(traits_type::to_char_type(c));
+}
+
+std::streamsize Output::xsputn(const char *s, std::streamsize n)
+{
+  // copy into the buffer if there is room, otherwise empty it first
+  if (n > epptr() - pptr())
+  {
+    if (not flush())
+    {
+      return 0;
+    }
+
+    // too big to buffer at all
+    if (n > epptr() - pptr())
+    {
+      return write(s, n) ? n : 0;
+    }
+  }
+  memcpy(pptr(), s, n);
+  pbump((int)n);
+  return n;
+}
+
+// std::cout was flushed
+int Output::sync()
+{
+  return flush() ? 0 : -1;
+}
+
+// write size bytes straight to stdout
+bool Output::write(const char *data, size_t size)
+{
+  while (size > 0)
+  {
+    ssize_t written = ::write(STDOUT_FILENO, data, size);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
@@ -0,0 +1,40 @@
+// File: output.h
+// Purpose: The interpreter's output sink, which batches everything a
+//          program prints into large writes.
+#ifndef OUTPUT_H
+#define OUTPUT_H
+#include <streambuf>
+#include <vector>
+
+// While an Output exists it is std::cout's buffer, so all of a program's
+// output collects in one large buffer. That is written to stdout only when
+// it fills up, when std::cout is flushed (which happens before reading
+// std::cin or writing to std::cerr, as they are tied to it), and when the
+// Output is destroyed. An unbuffered Output writes everything immediately.
+class Output : public std::streambuf
+{
+public:
+  Output(bool buffered);
+  ~Output();
+
+  // write out everything collected so far, false if stdout failed
+  bool flush();
+
+protected:
+  int_type overflow(int_type c) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  std::vector<char> _buffer;
+  std::streambuf *_previous;  // std::cout's own buffer, restored at the end
+
+  // write size bytes straight to stdout
+  bool write(const char *data, size_t size);
+
+  // the sink replaces std::cout's buffer, so it cannot be copied
+  Output(const Output &) = delete;
+  Output &operator=(const Output &) = delete;
+};
+
+#endif
@@ -1,151 +1,108 @@
 // File: parse_tree.cpp
 // Purpose: Implementation of the parse tree classes
 #include "parse_tree.h"
+#include "batch_input.h"
+#include "company_db.h"
+#include "ref_env.h"
+#include "scope.h"
+#include "top_items.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
 #include <string>
 #include <vector>
-#include <fstream>
 
 // Closure Constructor
 Closure::Closure(Fun_Def *fun, Ref_Env *env)
 {
+  this->refs = 1;
   this->fun = fun;
   this->env = env;
+  this->code = nullptr;
+  env->retain();
 }
 
-//////////////////////////////////////////
-// Evaluation Results
-//////////////////////////////////////////
-EvalResult::EvalResult() { this->_type = VOID; }
-
-void EvalResult::set_type(EvalType _type)
-{
-  this->_type = _type;
-  this->_i = 0;
-  this->_d = 0;
-}
-
-// set the value and infer the type
-void EvalResult::set(int _i)
-{
-  this->_i = _i;
-  _type = INTEGER;
-}
-
-void EvalResult::set(std::string _str)
-{
-  this->_str = _str;
-  _type = STRING;
-}
-
-void EvalResult::set(double _d)
-{
-  this->_d = _d;
-  _type = REAL;
-}
-
-void EvalResult::set(bool _b)
+Closure::~Closure()
 {
-  this->_b = _b;
-  _type = BOOLEAN;
+  env->release();
 }
 
-void EvalResult::set(Closure *_fun)
+//////////////////////////////////////////
+// Evaluation Results
+//////////////////////////////////////////
+const std::string &EvalResult::empty_string()
 {
-  this->_fun = _fun;
-  _type = FUNCTION;
+  static const std::string empty;
+  return empty;
 }
 
-void EvalResult::set(std::vector<int> _myarray)
+const std::vector<long long> &EvalResult::empty_array()
 {
-  this->_myarray = _myarray;
-  _type = VECTOR;
+  static const std::vector<long long> empty;
+  return empty;
 }
 
-// type coercion functions
-int EvalResult::as_integer()
+// an integer or decimal result as a Decimal, false if it is out of range
+static bool decimal_of(const EvalResult &value, Decimal &result)
 {
-
-  if (_type == INTEGER)
+  if (value.type() == DECIMAL)
   {
-    return _i;
-  }
-  else
-  {
-    return (int)(_d);
+    result = value.as_decimal();
+    return true;
   }
+  return value.type() != BIGINT and Decimal::from_integer(value.as_integer(), result);
 }
 
-std::string EvalResult::as_string()
+// an integer result as a Big_Int, filling in scratch unless it is BIGINT
+static const Big_Int &big_of(const EvalResult &value, Big_Int &scratch)
 {
-  if (_type == STRING)
-  {
-    return _str;
-  }
-  else
+  if (const Big_Int *big = value.as_big())
   {
-    return std::string(_str);
+    return *big;
   }
+  scratch = Big_Int(value.as_integer());
+  return scratch;
 }
 
-double EvalResult::as_real()
-{
-  if (_type == REAL)
-  {
-    return _d;
-  }
-  else
-  {
-    return (double)_i;
-  }
-}
-
-bool EvalResult::as_bool()
+//////////////////////////////////////////
+// Base classes for the operators
+//////////////////////////////////////////
+void *Parse_Tree::operator new(size_t size, Arena &arena)
 {
-  return _b;
+  void *ptr = arena.allocate(size);
+  arena.on_destroy(ptr, [](void *node) { ((Parse_Tree *)node)->~Parse_Tree(); });
+  return ptr;
 }
 
-Closure *EvalResult::as_fun()
+void Parse_Tree::operator delete(void *ptr, Arena &arena)
 {
-  return _fun;
+  // the memory goes back when the arena is torn down
 }
 
-std::vector<int> EvalResult::as_array()
+void Parse_Tree::operator delete(void *ptr)
 {
-  if (_type == VECTOR && !_myarray.empty())
-  {
-    return _myarray;
-  }
-  // Handle the case where the type is not an array or the array is empty
-  return std::vector<int>();
+  // the memory goes back when the arena is torn down
 }
 
-// retrieve the type
-EvalType EvalResult::type() { return _type; }
-
-//////////////////////////////////////////
-// Base classes for the operators
-//////////////////////////////////////////
 Parse_Tree::~Parse_Tree()
 {
   // nothing to do
 }
 
-// destructor
-UnaryOp::~UnaryOp() { delete child(); }
+// destructor (the arena owns the child)
+UnaryOp::~UnaryOp() {}
 
 // accessor and mutator for the child
 Parse_Tree *UnaryOp::child() const { return _child; }
 
 void UnaryOp::child(Parse_Tree *_child) { this->_child = _child; }
 
-BinaryOp::~BinaryOp()
-{
-  delete left();
-  delete right();
-}
+// destructor (the arena owns the children)
+BinaryOp::~BinaryOp() {}
 
 // accessor and mutator for the children
 Parse_Tree *BinaryOp::left() const { return _left; }
@@ -156,13 +113,8 @@ Parse_Tree *BinaryOp::right() const { return _right; }
 
 void BinaryOp::right(Parse_Tree *_right) { this->_right = _right; }
 
-NaryOp::~NaryOp()
-{
-  for (auto itr = begin(); itr != end(); itr++)
-  {
-    delete *itr;
-  }
-}
+// destructor (the arena owns the children)
+NaryOp::~NaryOp() {}
 
 // add a child
 void NaryOp::add(Parse_Tree *child) { _children.push_back(child); }
@@ -189,6 +141,11 @@ EvalResult Program::eval(Ref_Env *env)
   for (auto itr = begin(); itr != end(); itr++)
   {
     result = (*itr)->eval(env);
+    if (result.type() == TAIL_CALL)
+    {
+      // unwind to the call this body belongs to
+      break;
+    }
   }
 
   return result;
@@ -209,10 +166,16 @@ void Program::print(int indent) const
 
 EvalResult Add::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Add::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   // handle our types (TODO: This will become more complicated later)
   if (l.type() == REAL or r.type() == REAL)
   {
@@ -225,11 +188,33 @@ EvalResult Add::eval(Ref_Env *env)
     std::string x = l.as_string() + r.as_string();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    // fixed point arithmetic, which becomes real if it overflows
+    Decimal a, b, x;
+    if (decimal_of(l, a) and decimal_of(r, b) and Decimal::add(a, b, x))
+    {
+      result.set(x);
+    }
+    else
+    {
+      result.set(l.as_real() + r.as_real());
+    }
+  }
   else
   {
-    // integer arithmetic
-    int x = l.as_integer() + r.as_integer();
-    result.set(x);
+    // integer arithmetic, which becomes big if it overflows
+    long long x;
+    if (l.type() == BIGINT or r.type() == BIGINT or
+        __builtin_add_overflow(l.as_integer(), r.as_integer(), &x))
+    {
+      Big_Int a, b;
+      result.set(big_of(l, a) + big_of(r, b));
+    }
+    else
+    {
+      result.set(x);
+    }
   }
 
   return result;
@@ -250,10 +235,16 @@ void Add::print(int indent) const
 
 EvalResult Subtract::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Subtract::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   // handle our types (TODO: This will become more complicated later)
   if (l.type() == REAL or r.type() == REAL)
   {
@@ -261,11 +252,33 @@ EvalResult Subtract::eval(Ref_Env *env)
     double x = l.as_real() - r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    // fixed point arithmetic, which becomes real if it overflows
+    Decimal a, b, x;
+    if (decimal_of(l, a) and decimal_of(r, b) and Decimal::subtract(a, b, x))
+    {
+      result.set(x);
+    }
+    else
+    {
+      result.set(l.as_real() - r.as_real());
+    }
+  }
   else
   {
-    // integer arithmetic
-    int x = l.as_integer() - r.as_integer();
-    result.set(x);
+    // integer arithmetic, which becomes big if it overflows
+    long long x;
+    if (l.type() == BIGINT or r.type() == BIGINT or
+        __builtin_sub_overflow(l.as_integer(), r.as_integer(), &x))
+    {
+      Big_Int a, b;
+      result.set(big_of(l, a) - big_of(r, b));
+    }
+    else
+    {
+      result.set(x);
+    }
   }
   return result;
 }
@@ -285,10 +298,16 @@ void Subtract::print(int indent) const
 
 EvalResult Multiply::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Multiply::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   // handle our types (TODO: This will become more complicated later)
   if (l.type() == REAL or r.type() == REAL)
   {
@@ -296,11 +315,33 @@ EvalResult Multiply::eval(Ref_Env *env)
     double x = l.as_real() * r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    // fixed point arithmetic, which becomes real if it overflows
+    Decimal a, b, x;
+    if (decimal_of(l, a) and decimal_of(r, b) and Decimal::multiply(a, b, x))
+    {
+      result.set(x);
+    }
+    else
+    {
+      result.set(l.as_real() * r.as_real());
+    }
+  }
   else
   {
-    // integer arithmetic
-    int x = l.as_integer() * r.as_integer();
-    result.set(x);
+    // integer arithmetic, which becomes big if it overflows
+    long long x;
+    if (l.type() == BIGINT or r.type() == BIGINT or
+        __builtin_mul_overflow(l.as_integer(), r.as_integer(), &x))
+    {
+      Big_Int a, b;
+      result.set(big_of(l, a) * big_of(r, b));
+    }
+    else
+    {
+      result.set(x);
+    }
   }
   return result;
 }
@@ -320,10 +361,16 @@ void Multiply::print(int indent) const
 
 EvalResult Divide::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Divide::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   // handle our types (TODO: This will become more complicated later)
   if (l.type() == REAL or r.type() == REAL)
   {
@@ -331,11 +378,38 @@ EvalResult Divide::eval(Ref_Env *env)
     double x = l.as_real() / r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    // fixed point arithmetic, rounded to six places
+    Decimal a, b, x;
+    if (decimal_of(l, a) and decimal_of(r, b) and Decimal::divide(a, b, x))
+    {
+      result.set(x);
+    }
+    else
+    {
+      result.set(l.as_real() / r.as_real());
+    }
+  }
   else
   {
-    // integer arithmetic
-    int x = l.as_integer() / r.as_integer();
-    result.set(x);
+    // integer arithmetic (the one quotient which overflows becomes big)
+    long long a = l.as_integer();
+    long long b = r.as_integer();
+    if ((l.type() == BIGINT or r.type() == BIGINT) and b != 0)
+    {
+      Big_Int x, y, quotient, remainder;
+      Big_Int::divide(big_of(l, x), big_of(r, y), quotient, remainder);
+      result.set(quotient);
+    }
+    else if (a == LLONG_MIN and b == -1)
+    {
+      result.set(-Big_Int(a));
+    }
+    else
+    {
+      result.set(a / b);
+    }
   }
   return result;
 }
@@ -355,12 +429,29 @@ void Divide::print(int indent) const
 
 EvalResult Mod::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
-  // we always return integer
-  result.set(l.as_integer() % r.as_integer());
+  return apply(l, r);
+}
+
+EvalResult Mod::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
+  // we always return integer (LLONG_MIN MOD -1 is 0, but traps in C++)
+  long long a = l.as_integer();
+  long long b = r.as_integer();
+  if ((l.type() == BIGINT or r.type() == BIGINT) and b != 0)
+  {
+    Big_Int x, y, quotient, remainder;
+    Big_Int::divide(big_of(l, x), big_of(r, y), quotient, remainder);
+    result.set(remainder);
+  }
+  else
+  {
+    result.set(b == -1 ? 0 : a % b);
+  }
 
   return result;
 }
@@ -380,12 +471,68 @@ void Mod::print(int indent) const
 
 EvalResult Power::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
-  // power always returns real
-  result.set(pow(l.as_real(), r.as_real()));
+  return apply(l, r);
+}
+
+// big integer powers with more bits than this are left to pow()
+static const long long max_power_bits = 1 << 24;
+
+// true if base ^ exp is small enough to work out exactly
+static bool power_fits(const Big_Int &base, long long exp)
+{
+  return base.bits() <= 1 or exp <= max_power_bits / (long long)base.bits();
+}
+
+// base ^ exp by repeated squaring, returns false if it overflows
+static bool integer_power(long long base, long long exp, long long &result)
+{
+  long long x = 1;
+  while (true)
+  {
+    if (exp & 1 and __builtin_mul_overflow(x, base, &x))
+    {
+      return false;
+    }
+    exp >>= 1;
+    if (exp == 0)
+    {
+      break;
+    }
+    if (__builtin_mul_overflow(base, base, &base))
+    {
+      return false;
+    }
+  }
+
+  result = x;
+  return true;
+}
+
+EvalResult Power::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
+  // integer powers stay integers (big ones if they overflow), unless
+  // they are fractions or absurdly large
+  long long x;
+  Big_Int a;
+  if (l.type() == INTEGER and r.type() == INTEGER and r.as_integer() >= 0 and
+      integer_power(l.as_integer(), r.as_integer(), x))
+  {
+    result.set(x);
+  }
+  else if ((l.type() == INTEGER or l.type() == BIGINT) and r.type() == INTEGER and
+           r.as_integer() >= 0 and power_fits(big_of(l, a), r.as_integer()))
+  {
+    result.set(big_of(l, a).pow(r.as_integer()));
+  }
+  else
+  {
+    result.set(pow(l.as_real(), r.as_real()));
+  }
 
   return result;
 }
@@ -405,16 +552,39 @@ void Power::print(int indent) const
 
 EvalResult Negation::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult c = child()->eval(env);
 
+  return apply(c);
+}
+
+EvalResult Negation::apply(const EvalResult &c)
+{
+  EvalResult result;
+
+  Decimal x;
   if (c.type() == REAL)
   {
     result.set(-1 * c.as_real());
   }
+  else if (c.type() == DECIMAL)
+  {
+    if (Decimal::subtract(Decimal(), c.as_decimal(), x))
+    {
+      result.set(x);
+    }
+    else
+    {
+      result.set(-c.as_real());
+    }
+  }
+  else if (c.type() == BIGINT or c.as_integer() == LLONG_MIN)
+  {
+    Big_Int a;
+    result.set(-big_of(c, a));
+  }
   else
   {
-    result.set(-1 * c.as_integer());
+    result.set(-c.as_integer());
   }
 
   return result;
@@ -429,6 +599,74 @@ void Negation::print(int indent) const
   child()->print(indent + 1);
 }
 
+Constant::Constant(const EvalResult &value) : _value(value) {}
+
+EvalResult Constant::eval(Ref_Env *env)
+{
+  return _value;
+}
+
+// the value
+const EvalResult &Constant::value() const
+{
+  return _value;
+}
+
+void Constant::print(int indent) const
+{
+  // print ourself
+  std::cout << std::setw(indent) << " ";
+  if (_value.type() == BOOLEAN)
+  {
+    std::cout << (_value.as_bool() ? "true" : "false") << std::endl;
+  }
+  else
+  {
+    Display::show(_value);
+  }
+}
+
+EvalResult Square::eval(Ref_Env *env)
+{
+  EvalResult c = child()->eval(env);
+
+  return apply(c);
+}
+
+EvalResult Square::apply(const EvalResult &c)
+{
+  EvalResult result;
+
+  // the same as c ^ 2 (pow() is exact for squares)
+  long long i;
+  if (c.type() == INTEGER and not __builtin_mul_overflow(c.as_integer(), c.as_integer(), &i))
+  {
+    result.set(i);
+  }
+  else if (c.type() == INTEGER or c.type() == BIGINT)
+  {
+    Big_Int a;
+    result.set(big_of(c, a) * big_of(c, a));
+  }
+  else
+  {
+    double x = c.as_real();
+    result.set(x * x);
+  }
+
+  return result;
+}
+
+void Square::print(int indent) const
+{
+  // print the child
+  child()->print(indent + 1);
+
+  // indent and print ourself
+  std::cout << std::setw(indent) << "";
+  std::cout << "^ 2 (square)" << std::endl;
+}
+
 Literal::Literal(const Lexer_Token &tok) { this->_tok = tok; }
 
 EvalResult Literal::eval(Ref_Env *env)
@@ -437,7 +675,17 @@ EvalResult Literal::eval(Ref_Env *env)
 
   if (_tok.tok == INTLIT)
   {
-    result.set(stoi(_tok.lexeme));
+    // literals too big for 64 bits are big integers
+    try
+    {
+      result.set(stoll(std::string(_tok.lexeme)));
+    }
+    catch (const std::out_of_range &e)
+    {
+      Big_Int big;
+      Big_Int::parse(_tok.lexeme, big);
+      result.set(big);
+    }
   }
   else if (_tok.tok == STRLIT)
   {
@@ -445,7 +693,7 @@ EvalResult Literal::eval(Ref_Env *env)
   }
   else
   {
-    result.set(stof(_tok.lexeme));
+    result.set(stof(std::string(_tok.lexeme)));
   }
 
   return result;
@@ -458,12 +706,26 @@ void Literal::print(int indent) const
   std::cout << _tok.lexeme << std::endl;
 }
 
-Variable::Variable(const Lexer_Token &tok) { this->_tok = tok; }
+Variable::Variable(const Lexer_Token &tok)
+{
+  this->_tok = tok;
+  this->_depth = 0;
+  this->_slot = -1;
+  this->_shadows = false;
+}
 
 EvalResult Variable::eval(Ref_Env *env)
 {
   // retrieve the variable
-  return env->get(_tok.lexeme);
+  if (_slot >= 0)
+  {
+    EvalResult &value = env->at(_depth, _slot);
+    if (not _shadows or value.type() != UNDEFINED)
+    {
+      return value;
+    }
+  }
+  return env->get(name());
 }
 
 void Variable::print(int indent) const
@@ -475,10 +737,48 @@ void Variable::print(int indent) const
 
 void Variable::set(Ref_Env *env, EvalResult value)
 {
-  env->set(_tok.lexeme, value);
+  if (_slot < 0)
+  {
+    env->set(name(), value);
+    return;
+  }
+
+  // an unassigned shadowing slot defers to an assigned outer binding
+  EvalResult *ptr = &env->at(_depth, _slot);
+  if (_shadows and ptr->type() == UNDEFINED)
+  {
+    EvalResult *outer = env->lookup(name());
+    if (outer != nullptr)
+    {
+      ptr = outer;
+    }
+  }
+  *ptr = value;
 }
 
-std::string Variable::name() const { return _tok.lexeme; }
+std::string Variable::name() const { return std::string(_tok.lexeme); }
+
+// the variable's storage, or nullptr if it is unbound
+EvalResult *Variable::lookup(Ref_Env *env)
+{
+  if (_slot < 0)
+  {
+    return env->lookup(name());
+  }
+
+  EvalResult *ptr = &env->at(_depth, _slot);
+  if (ptr->type() == UNDEFINED)
+  {
+    return _shadows ? env->lookup(name()) : nullptr;
+  }
+  return ptr;
+}
+
+int Variable::depth() const { return _depth; }
+
+int Variable::slot() const { return _slot; }
+
+bool Variable::shadows() const { return _shadows; }
 
 EvalResult Assignment::eval(Ref_Env *env)
 {
@@ -509,31 +809,66 @@ EvalResult Display::eval(Ref_Env *env)
 
   // get the value to print
   EvalResult value = child()->eval(env);
+  show(value);
+
+  return result;
+}
+
+// values are formatted with to_chars and written straight to std::cout's
+// buffer (the interpreter's Output sink), a line at a time and without
+// flushing
+void Display::show(const EvalResult &value)
+{
+  std::streambuf *out = std::cout.rdbuf();
+  char buffer[4096];
+  char *p = buffer, *end = buffer + sizeof(buffer);
 
   if (value.type() == INTEGER)
   {
-    std::cout << value.as_integer() << std::endl;
+    p = std::to_chars(p, end, value.as_integer()).ptr;
   }
   else if (value.type() == STRING)
   {
-    std::cout << value.as_string() << std::endl;
+    const std::string &text = value.as_string();
+    out->sputn(text.data(), text.size());
   }
   else if (value.type() == REAL)
   {
-    std::cout << value.as_real() << std::endl;
+    // the same as operator<< gives
+    p = std::to_chars(p, end, value.as_real(), std::chars_format::general, 6).ptr;
+  }
+  else if (value.type() == BIGINT)
+  {
+    std::string text = value.as_big()->to_string();
+    out->sputn(text.data(), text.size());
+  }
+  else if (value.type() == DECIMAL)
+  {
+    std::string text = value.as_decimal().to_string();
+    out->sputn(text.data(), text.size());
   }
   else if (value.type() == VECTOR)
   {
-    std::vector<int, std::allocator<int> > arrayElements = value.as_array();
-
-    std::cout << "[";
-    for (const int &element : arrayElements)
+    *p++ = '[';
+    for (long long element : value.as_array())
     {
-      std::cout << element << ",";
+      if (end - p < 32)
+      {
+        out->sputn(buffer, p - buffer);
+        p = buffer;
+      }
+      p = std::to_chars(p, end, element).ptr;
+      *p++ = ',';
     }
-    std::cout << "]" << std::endl;
+    *p++ = ']';
   }
-  return result;
+  else
+  {
+    return;
+  }
+
+  *p++ = '\n';
+  out->sputn(buffer, p - buffer);
 }
 
 void Display::print(int indent) const
@@ -545,60 +880,124 @@ void Display::print(int indent) const
   child()->print(indent + 1);
 }
 
-EvalResult Input::eval(Ref_Env *env)
+// how the text given to an input statement was read
+enum Input_Status
 {
-  EvalResult result;
-  Variable *v = static_cast<Variable *>(child());
-  std::string input;
+  INPUT_OK,
+  INPUT_NOT_NUMBER,  // neither quoted nor starting with a number
+  INPUT_BAD_NUMBER   // a number followed by something else
+};
 
-  // print the prompt and get the input
-  std::cout << v->name() << "=";
+// read a value given to an input statement: a quoted string, a whole number
+// (a BIGINT if it does not fit in 64 bits), an amount with up to six places
+// (read exactly) or a real. This is called for every value a batch run is
+// fed, so it reports bad input by status rather than by exception.
+static Input_Status parse_input(std::string_view input, EvalResult &value)
+{
+  if (input.size() >= 2 and input.front() == '"' and input.back() == '"')
+  {
+    value.set(std::string(input.substr(1, input.size() - 2)));
+    return INPUT_OK;
+  }
 
-  // Read the entire line, including spaces
-  std::getline(std::cin, input);
+  // a number may have leading spaces and a plus sign, but nothing after it
+  std::string_view text = input;
+  while (not text.empty() and std::isspace((unsigned char)text.front()))
+  {
+    text.remove_prefix(1);
+  }
+  if (text.size() > 1 and text[0] == '+' and text[1] != '+' and text[1] != '-')
+  {
+    text.remove_prefix(1);
+  }
+  const char *first = text.data();
+  const char *last = first + text.size();
 
-  // Check if the input starts and ends with double quotes, treat as string
-  if (input.size() >= 2 && input.front() == '"' && input.back() == '"')
+  long long integer;
+  std::from_chars_result whole = std::from_chars(first, last, integer);
+  if (whole.ec == std::errc() and whole.ptr == last)
   {
-    input = input.substr(1, input.size() - 2); // Remove the double quotes
-    EvalResult value;
-    value.set(input);
-    v->set(env, value);
+    value.set(integer);
+    return INPUT_OK;
   }
-  else
+
+  Big_Int big;
+  if (whole.ec == std::errc::result_out_of_range and Big_Int::parse(text, big))
   {
-    // Check if the input is numeric
-    try
-    {
-      size_t pos;
-      double num = std::stod(input, &pos);
+    value.set(big);
+    return INPUT_OK;
+  }
 
-      if (pos == input.size())
-      {
-        EvalResult value;
-
-        // Check if the numeric value is an integer or has a fractional part
-        if (std::floor(num) == num)
-        {
-          value.set(static_cast<int>(num));
-        }
-        else
-        {
-          value.set(num);
-        }
-
-        v->set(env, value);
-      }
-      else
-      {
-        std::cerr << "Invalid numeric input: " << input << std::endl;
-      }
+  Decimal amount;
+  if (Decimal::parse(text, amount) and not amount.whole())
+  {
+    value.set(amount);
+    return INPUT_OK;
+  }
+
+  double num;
+  std::from_chars_result real = std::from_chars(first, last, num);
+  if (real.ec == std::errc() and real.ptr == last)
+  {
+    // whole reals (e.g. 1e3) are integers
+    if (std::floor(num) == num and num >= -9.2e18 and num <= 9.2e18)
+    {
+      value.set(static_cast<long long>(num));
     }
-    catch (const std::invalid_argument &e)
+    else
+    {
+      value.set(num);
+    }
+    return INPUT_OK;
+  }
+
+  return whole.ptr == first and real.ptr == first ? INPUT_NOT_NUMBER : INPUT_BAD_NUMBER;
+}
+
+EvalResult Input::eval(Ref_Env *env)
+{
+  EvalResult result;
+  Variable *v = static_cast<Variable *>(child());
+  std::string line;
+  std::string_view input;
+
+  // DB records held back are written before the program waits for the user,
+  // who may take longer than any delay; batch input only writes those due
+  Batch_Input *batch = Batch_Input::active();
+  if (not (batch ? Company_DB::flush_due() : Company_DB::flush_all()))
+  {
+    std::cerr << "Failed to write to file" << std::endl;
+  }
+  if (batch)
+  {
+    // batch runs have no prompts, the end of the input reads as empty
+    if (not batch->next_line(input))
     {
-      std::cerr << "Invalid input: " << input << std::endl;
+      input = std::string_view();
     }
   }
+  else
+  {
+    // print the prompt (and everything before it) and read the entire line
+    std::cout << v->name() << "=";
+    std::cout.flush();
+    std::getline(std::cin, line);
+    input = line;
+  }
+
+  EvalResult value;
+  switch (parse_input(input, value))
+  {
+  case INPUT_OK:
+    v->set(env, value);
+    break;
+  case INPUT_NOT_NUMBER:
+    std::cerr << "Invalid input: " << input << std::endl;
+    break;
+  case INPUT_BAD_NUMBER:
+    std::cerr << "Invalid numeric input: " << input << std::endl;
+    break;
+  }
 
   return result;
 }
@@ -637,7 +1036,7 @@ Record_Declaration::Record_Declaration(const Lexer_Token &_tok)
 
 std::string Record_Declaration::name()
 {
-  return _tok.lexeme;
+  return std::string(_tok.lexeme);
 }
 
 EvalResult Record_Declaration::eval(Ref_Env *env)
@@ -668,7 +1067,11 @@ EvalResult Branch::eval(Ref_Env *env)
 
   if (left()->eval(env).as_bool())
   {
-    right()->eval(env);
+    EvalResult body = right()->eval(env);
+    if (body.type() == TAIL_CALL)
+    {
+      return body;
+    }
   }
 
   return result;
@@ -714,10 +1117,16 @@ void Loop::print(int indent) const
 
 EvalResult Equal::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Equal::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   // handle our types (TODO: This will become more complicated later)
   if (l.type() == REAL or r.type() == REAL)
   {
@@ -725,6 +1134,18 @@ EvalResult Equal::eval(Ref_Env *env)
     bool x = l.as_real() == r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    Decimal a, b;
+    bool x = decimal_of(l, a) and decimal_of(r, b) ? Decimal::compare(a, b) == 0 : l.as_real() == r.as_real();
+    result.set(x);
+  }
+  else if (l.type() == BIGINT or r.type() == BIGINT)
+  {
+    Big_Int a, b;
+    bool x = Big_Int::compare(big_of(l, a), big_of(r, b)) == 0;
+    result.set(x);
+  }
   else
   {
     // integer arithmetic
@@ -749,17 +1170,34 @@ void Equal::print(int indent) const
 
 EvalResult Not_Equal::eval(Ref_Env *env)
 {
-  EvalResult result;
-
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Not_Equal::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   if (l.type() == REAL or r.type() == REAL)
   {
     // real arithmetic
     bool x = l.as_real() != r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    Decimal a, b;
+    bool x = decimal_of(l, a) and decimal_of(r, b) ? Decimal::compare(a, b) != 0 : l.as_real() != r.as_real();
+    result.set(x);
+  }
+  else if (l.type() == BIGINT or r.type() == BIGINT)
+  {
+    Big_Int a, b;
+    bool x = Big_Int::compare(big_of(l, a), big_of(r, b)) != 0;
+    result.set(x);
+  }
   else
   {
     // integer arithmetic
@@ -785,17 +1223,34 @@ void Not_Equal::print(int indent) const
 
 EvalResult Greater::eval(Ref_Env *env)
 {
-  EvalResult result;
-
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Greater::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   if (l.type() == REAL or r.type() == REAL)
   {
     // real arithmetic
     bool x = l.as_real() > r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    Decimal a, b;
+    bool x = decimal_of(l, a) and decimal_of(r, b) ? Decimal::compare(a, b) > 0 : l.as_real() > r.as_real();
+    result.set(x);
+  }
+  else if (l.type() == BIGINT or r.type() == BIGINT)
+  {
+    Big_Int a, b;
+    bool x = Big_Int::compare(big_of(l, a), big_of(r, b)) > 0;
+    result.set(x);
+  }
   else
   {
     // integer arithmetic
@@ -821,10 +1276,16 @@ void Greater::print(int indent) const
 
 EvalResult Less::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Less::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   // handle our types (TODO: This will become more complicated later)
   if (l.type() == REAL or r.type() == REAL)
   {
@@ -832,6 +1293,18 @@ EvalResult Less::eval(Ref_Env *env)
     bool x = l.as_real() < r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    Decimal a, b;
+    bool x = decimal_of(l, a) and decimal_of(r, b) ? Decimal::compare(a, b) < 0 : l.as_real() < r.as_real();
+    result.set(x);
+  }
+  else if (l.type() == BIGINT or r.type() == BIGINT)
+  {
+    Big_Int a, b;
+    bool x = Big_Int::compare(big_of(l, a), big_of(r, b)) < 0;
+    result.set(x);
+  }
   else
   {
     // integer arithmetic
@@ -857,10 +1330,16 @@ void Less::print(int indent) const
 
 EvalResult Less_or_Equal::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Less_or_Equal::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   // handle our types (TODO: This will become more complicated later)
   if (l.type() == REAL or r.type() == REAL)
   {
@@ -868,6 +1347,18 @@ EvalResult Less_or_Equal::eval(Ref_Env *env)
     bool x = l.as_real() <= r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    Decimal a, b;
+    bool x = decimal_of(l, a) and decimal_of(r, b) ? Decimal::compare(a, b) <= 0 : l.as_real() <= r.as_real();
+    result.set(x);
+  }
+  else if (l.type() == BIGINT or r.type() == BIGINT)
+  {
+    Big_Int a, b;
+    bool x = Big_Int::compare(big_of(l, a), big_of(r, b)) <= 0;
+    result.set(x);
+  }
   else
   {
     // integer arithmetic
@@ -893,10 +1384,16 @@ void Less_or_Equal::print(int indent) const
 
 EvalResult Greater_or_Equal::eval(Ref_Env *env)
 {
-  EvalResult result;
   EvalResult l = left()->eval(env);
   EvalResult r = right()->eval(env);
 
+  return apply(l, r);
+}
+
+EvalResult Greater_or_Equal::apply(const EvalResult &l, const EvalResult &r)
+{
+  EvalResult result;
+
   // handle our types (TODO: This will become more complicated later)
   if (l.type() == REAL or r.type() == REAL)
   {
@@ -904,6 +1401,18 @@ EvalResult Greater_or_Equal::eval(Ref_Env *env)
     bool x = l.as_real() >= r.as_real();
     result.set(x);
   }
+  else if (l.type() == DECIMAL or r.type() == DECIMAL)
+  {
+    Decimal a, b;
+    bool x = decimal_of(l, a) and decimal_of(r, b) ? Decimal::compare(a, b) >= 0 : l.as_real() >= r.as_real();
+    result.set(x);
+  }
+  else if (l.type() == BIGINT or r.type() == BIGINT)
+  {
+    Big_Int a, b;
+    bool x = Big_Int::compare(big_of(l, a), big_of(r, b)) >= 0;
+    result.set(x);
+  }
   else
   {
     // integer arithmetic
@@ -965,13 +1474,19 @@ void Parse_List::print(int indent) const
 
 Fun_Def::Fun_Def(const Lexer_Token &tok) : var(tok)
 {
+  _scope = nullptr;
+}
+
+Fun_Def::~Fun_Def()
+{
+  delete _scope;
 }
 
 EvalResult Fun_Def::eval(Ref_Env *env)
 {
   EvalResult value;
   value.set(new Closure(this, env));
-  env->set(name(), value);
+  var.set(env, value);
   return EvalResult();
 }
 
@@ -980,6 +1495,12 @@ std::string Fun_Def::name() const
   return var.name();
 }
 
+// the scope of the function body (nullptr until resolved)
+Scope *Fun_Def::scope() const
+{
+  return _scope;
+}
+
 void Fun_Def::print(int indent) const
 {
   // print ourself
@@ -993,6 +1514,34 @@ void Fun_Def::print(int indent) const
   right()->print(indent + 1);
 }
 
+// The tail call waiting for its caller's activation to be released
+struct Tail_Call
+{
+  EvalResult fun;
+  std::vector<EvalResult> args;
+  bool discard;
+};
+static Tail_Call pending;
+
+Fun_Call::Fun_Call()
+{
+  _tail = false;
+  _discard = false;
+}
+
+// true if none of the guards hold in env
+bool Fun_Call::unguarded(Ref_Env *env)
+{
+  for (Parse_Tree *guard : _guards)
+  {
+    if (guard->eval(env).as_bool())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
 EvalResult Fun_Call::eval(Ref_Env *env)
 {
   // retrieve the function
@@ -1015,17 +1564,59 @@ EvalResult Fun_Call::eval(Ref_Env *env)
     return EvalResult();
   }
 
+  if (_tail and unguarded(env))
+  {
+    // leave the call to the caller's Fun_Call, once our activation is gone
+    pending.fun = fr;
+    pending.args.clear();
+    for (auto aitr = args->begin(); aitr != args->end(); aitr++)
+    {
+      pending.args.push_back((*aitr)->eval(env));
+    }
+    pending.discard = _discard;
+
+    EvalResult result;
+    result.set_type(TAIL_CALL);
+    return result;
+  }
+
   // Create a local scope and bind the arguments
-  Ref_Env *local = new Ref_Env(closure->env);
+  Ref_Env *local = Ref_Env::activate(closure->env, closure->fun->scope());
   for (auto pitr = params->begin(), aitr = args->begin(); pitr != params->end(); pitr++, aitr++)
   {
     Variable *var = (Variable *)(*pitr);
     Parse_Tree *arg = *aitr;
-    local->declare(var->name());     // <-- Forces the parameter to be local
-    var->set(local, arg->eval(env)); // <-- Binds the argument
+    var->set(local, arg->eval(env)); // <-- Binds the argument (params are local slots)
   }
 
-  return closure->fun->right()->eval(local);
+  // run the body, and any calls in its tail position in its place
+  Fun_Def *fun = closure->fun;
+  bool discard = false;
+  for (;;)
+  {
+    // the activation keeps what it needs of the closure (its environment),
+    // and holding the closure too would hide a cycle through a nested fun
+    fr = EvalResult();
+
+    // the local scope lives on only if a closure captured it
+    EvalResult result = fun->right()->eval(local);
+    local->release();
+    if (result.type() != TAIL_CALL)
+    {
+      return discard ? EvalResult() : result;
+    }
+
+    // (the tail call checked its function and arguments)
+    fr = std::move(pending.fun);
+    closure = fr.as_fun();
+    fun = closure->fun;
+    discard = discard or pending.discard;
+    local = Ref_Env::activate(closure->env, fun->scope());
+    for (size_t i = 0; i < pending.args.size(); i++)
+    {
+      local->slot(i) = std::move(pending.args[i]);
+    }
+  }
 }
 
 void Fun_Call::print(int indent) const
@@ -1037,23 +1628,23 @@ void Fun_Call::print(int indent) const
 }
 
 Array_Declaration::Array_Declaration(const Lexer_Token &type, const Lexer_Token &bound, const Lexer_Token &name)
-    : type_(type), bound_(bound), name_(name) {}
+    : type_(type), bound_(bound), name_(name), bound_var(bound), name_var(name) {}
 
 EvalResult Array_Declaration::eval(Ref_Env *env)
 {
-  std::string ref_type = type_.lexeme; // Assuming type_ is a Lexer_Token
-  std::string name = name_.lexeme;     // Assuming name_ is a Lexer_Token
+  std::string ref_type(type_.lexeme); // Assuming type_ is a Lexer_Token
+  std::string name(name_.lexeme);     // Assuming name_ is a Lexer_Token
 
-  int bounds = 0;
+  long long bounds = 0;
 
   if (bound_.tok == INTLIT)
   {
-    bounds = std::stoi(bound_.lexeme); // If it's an integer literal, use its value
+    bounds = std::stoll(std::string(bound_.lexeme)); // If it's an integer literal, use its value
   }
   else if (bound_.tok == ID)
   {
     // If it's an identifier, look up its value in the environment
-    EvalResult boundResult = env->get(bound_.lexeme);
+    EvalResult boundResult = bound_var.eval(env);
     if (boundResult.as_integer())
     {
       bounds = boundResult.as_integer();
@@ -1070,9 +1661,11 @@ EvalResult Array_Declaration::eval(Ref_Env *env)
     return EvalResult(); // Return an error result or throw an exception
   }
 
-  std::vector<int> arrayValues;
+  // leave room for the declared bound up front
+  std::vector<long long> arrayValues;
+  arrayValues.reserve(bounds > 0 ? bounds : 0);
 
-  if (env->lookup(name))
+  if (name_var.lookup(env))
   {
     std::cerr << "Error: Array '" << name << "' is already defined." << std::endl;
     return EvalResult();
@@ -1081,7 +1674,7 @@ EvalResult Array_Declaration::eval(Ref_Env *env)
   result.set(arrayValues);
 
   // Assign the array to the environment
-  env->set(name, result);
+  name_var.set(env, result);
 
   return EvalResult(); // Return some result if needed
 }
@@ -1119,19 +1712,8 @@ EvalResult ArrayAssignment::eval(Ref_Env *env)
       std::cerr << "Error: " << arrayVariable->name() << " is not an array." << std::endl;
       return EvalResult(); // Return an undefined result
     }
-    // Get the array name
-    std::string arrayName = arrayVariable->name();
-
-    // Retrieve the vector from EvalResult
-    std::vector<int> arrayValues = arrayResult.as_array();
-
-    // Push the value to the end of the array
-    arrayValues.push_back(right()->eval(env).as_integer());
-
-    // Update the array in the environment
-    EvalResult updatedArray;
-    updatedArray.set(arrayValues);
-    env->set(arrayName, updatedArray);
+    // Push the value to the end of the shared array
+    arrayResult.array().push_back(right()->eval(env).as_integer());
   }
   return result;
 }
@@ -1144,7 +1726,7 @@ void ArrayAssignment::print(int indent) const
 }
 
 Array_Access::Array_Access(const Lexer_Token &name_array, Lexer_Token &index)
-    : name_array(name_array), index_(index)
+    : name_array(name_array), index_(index), array_var(name_array), index_var(index)
 {
   // Constructor implementation if needed
 }
@@ -1152,18 +1734,18 @@ Array_Access::Array_Access(const Lexer_Token &name_array, Lexer_Token &index)
 EvalResult Array_Access::eval(Ref_Env *env)
 {
   // Retrieve the array name
-  std::string arrayName = name_array.lexeme;
+  std::string_view arrayName = name_array.lexeme;
 
   // Check if the array variable exists in the environment
-  EvalResult *arrayVar = env->lookup(arrayName);
+  EvalResult *arrayVar = array_var.lookup(env);
 
-  EvalResult *arrayval = env->lookup(index_.lexeme);
+  EvalResult *arrayval = index_var.lookup(env);
 
-  int arr_index = 0;
+  long long arr_index = 0;
 
   if (!arrayval)
   {
-    arr_index = std::atoi(index_.lexeme.c_str());
+    arr_index = std::atoll(std::string(index_.lexeme).c_str());
   }
   else
   {
@@ -1171,14 +1753,14 @@ EvalResult Array_Access::eval(Ref_Env *env)
   }
 
   // Check if the arrayVar is an array
-  if (arrayVar->type() != EvalType::VECTOR)
+  if (!arrayVar || arrayVar->type() != EvalType::VECTOR)
   {
     std::cerr << "Error: " << arrayName << " is not an array." << std::endl;
     return EvalResult(); // Return an undefined result
   }
 
   // // Retrieve the vector from EvalResult
-  std::vector<int> arrayValues = arrayVar->as_array();
+  const std::vector<long long> &arrayValues = arrayVar->as_array();
 
   // // Check if the index is within bounds
   if (arr_index < 0 || arr_index >= arrayValues.size())
@@ -1202,27 +1784,28 @@ void Array_Access::print(int indent) const
 }
 
 Array_Update::Array_Update(const Lexer_Token &name_array, Lexer_Token &index, Lexer_Token &update_value)
-    : name_array(name_array), index_(index), update_value_(update_value)
+    : name_array(name_array), index_(index), update_value_(update_value),
+      array_var(name_array), index_var(index), value_var(update_value)
 {
 }
 
 EvalResult Array_Update::eval(Ref_Env *env)
 {
-  std::string arrayName = name_array.lexeme;
+  std::string_view arrayName = name_array.lexeme;
 
-  EvalResult *arrayVar = env->lookup(arrayName);
+  EvalResult *arrayVar = array_var.lookup(env);
 
-  if (arrayVar->type() != EvalType::VECTOR)
+  if (!arrayVar || arrayVar->type() != EvalType::VECTOR)
   {
     std::cerr << "Error: " << arrayName << " is not an array." << std::endl;
     return EvalResult(); // Return an undefined result
   }
 
-  int arr_index;
-  int update_val;
+  long long arr_index;
+  long long update_val;
 
-  EvalResult var_val = env->get(index_.lexeme);
-  EvalResult val_update = env->get(update_value_.lexeme);
+  EvalResult var_val = index_var.eval(env);
+  EvalResult val_update = value_var.eval(env);
 
   // Check if the index is a variable
   if (var_val.type() != UNDEFINED)
@@ -1234,7 +1817,7 @@ EvalResult Array_Update::eval(Ref_Env *env)
     // If the index is not a variable, assume it's a numeric value
     try
     {
-      arr_index = std::stoi(index_.lexeme);
+      arr_index = std::stoll(std::string(index_.lexeme));
     }
     catch (const std::invalid_argument &e)
     {
@@ -1253,7 +1836,7 @@ EvalResult Array_Update::eval(Ref_Env *env)
     // If the update value is not a variable, assume it's a numeric value
     try
     {
-      update_val = std::stoi(update_value_.lexeme);
+      update_val = std::stoll(std::string(update_value_.lexeme));
     }
     catch (const std::invalid_argument &e)
     {
@@ -1262,7 +1845,7 @@ EvalResult Array_Update::eval(Ref_Env *env)
     }
   }
 
-  std::vector<int> arrayValues = arrayVar->as_array();
+  std::vector<long long> &arrayValues = arrayVar->array();
 
   // Check if the index is within bounds
   if (arr_index < 0 || arr_index >= arrayValues.size())
@@ -1271,14 +1854,9 @@ EvalResult Array_Update::eval(Ref_Env *env)
     return EvalResult(); // Return an undefined result
   }
 
-  // Update the array value at the specified index
+  // Update the shared array in place
   arrayValues[arr_index] = update_val;
 
-  // Update the array in the environment
-  EvalResult updatedArray;
-  updatedArray.set(arrayValues); // Assuming set method is available in your EvalResult class
-  env->set(arrayName, updatedArray);
-
   return EvalResult();
 }
 
@@ -1290,7 +1868,7 @@ void Array_Update::print(int indent) const
 }
 
 Array_Size::Array_Size(const Lexer_Token &name_array)
-    : name_array(name_array)
+    : name_array(name_array), array_var(name_array)
 {
   // Constructor implementation if needed
 }
@@ -1298,21 +1876,19 @@ Array_Size::Array_Size(const Lexer_Token &name_array)
 EvalResult Array_Size::eval(Ref_Env *env)
 {
   // Retrieve the array name
-  std::string arrayName = name_array.lexeme;
+  std::string_view arrayName = name_array.lexeme;
 
   // Check if the array variable exists in the environment
-  EvalResult *arrayVar = env->lookup(arrayName);
+  EvalResult *arrayVar = array_var.lookup(env);
 
   // Check if the arrayVar is an array
-  if (arrayVar->type() != EvalType::VECTOR)
+  if (!arrayVar || arrayVar->type() != EvalType::VECTOR)
   {
     std::cerr << "Error: " << arrayName << " is not an array." << std::endl;
     return EvalResult(); // Return an undefined result
   }
 
-  // // Retrieve the vector from EvalResult
-  std::vector<int> arrayValues = arrayVar->as_array();
-  int arr_size = (int)arrayValues.size();
+  long long arr_size = (long long)arrayVar->as_array().size();
 
   // // Create a new EvalResult object and set its value
   EvalResult result;
@@ -1327,145 +1903,113 @@ void Array_Size::print(int indent) const
   std::cout << "Array Assignment" << std::endl;
 }
 
-struct Employee
+Load_File::Load_File(const Lexer_Token &name_array, const std::string &load_what, std::string &customer_number)
+    : name_array(name_array), load_what(load_what), customer_number(customer_number),
+      file_var(name_array), customer_var(Lexer_Token(ID, this->customer_number, name_array.line, name_array.col))
 {
-  std::string name;
-  std::string email;
-  std::string phone;
-  double salary;
-};
+  // Constructor implementation if needed
+}
 
-struct Purchase
+// a value as an amount of money (reals are rounded to six places)
+static Decimal money_of(const EvalResult &value)
 {
-  std::string itemName;
-  double price;
-  int quantity;
-};
+  Decimal amount;
+  bool ok = value.type() == REAL ? Decimal::from_real(value.as_real(), amount) : decimal_of(value, amount);
+  return ok ? amount : Decimal();
+}
 
-struct Customer
+// the total cost of a purchase, exact unless it overflows
+static void show_total(const Purchase &purchase)
 {
-  std::string name;
-  std::string email;
-  std::string phone;
-  std::vector<Purchase> purchases;
-};
+  Decimal quantity, total;
+  if (Decimal::from_integer(purchase.quantity, quantity) and Decimal::multiply(quantity, purchase.price, total))
+  {
+    std::cout << total.to_string();
+  }
+  else
+  {
+    std::cout << purchase.quantity * purchase.price.to_real();
+  }
+}
 
-Load_File::Load_File(const Lexer_Token &name_array, const std::string &load_what, std::string &customer_number)
-    : name_array(name_array), load_what(load_what), customer_number(customer_number)
+// one line of an employee listing
+static void show_employee(const Employee &emp)
 {
-  // Constructor implementation if needed
+  std::cout << emp.name << " < " << emp.email << " > "
+            << " Phone: " << emp.phone << "  Salary: $" << emp.salary.to_string() << "\n";
 }
 
-std::vector<Employee> employees;
-std::vector<Customer> customers;
-Purchase purchase;
-
 EvalResult Load_File::eval(Ref_Env *env)
 {
-  employees.clear();
-  customers.clear();
-
-  EvalResult var_val = env->get(name_array.lexeme);
+  EvalResult var_val = file_var.eval(env);
   std::string filename = var_val.as_string();
-  std::fstream infile(filename, std::ios::in);
-
-  if (!infile.is_open())
-  {
-    return EvalResult();
-  }
-
-  int numEmployees = 0;
-  infile >> numEmployees;
 
-  if (infile.fail())
+  // the DB is only read again if the file has changed
+  Company_DB *db = Company_DB::open(filename);
+  if (not db)
   {
     std::cerr << "Error reading the data." << std::endl;
     return EvalResult(); // Return an error code
   }
-  employees.clear(); // Clear the global vector before populating it
-  for (int i = 0; i < numEmployees; ++i)
+  if (not db->exists())
   {
-    Employee emp;
-    infile.ignore(); // Ignore the newline character after the number of employees
-    std::getline(infile, emp.name);
-    std::getline(infile, emp.email);
-    std::getline(infile, emp.phone);
-    infile >> emp.salary;
-    employees.push_back(emp);
-  }
-
-  int numCustomers = 0;
-  infile >> numCustomers;
-  infile.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Ignore the newline character after numCustomers
-
-  for (int i = 0; i < numCustomers; ++i)
-  {
-    Customer cust;
-    std::getline(infile >> std::ws, cust.name); // Read and skip leading whitespaces
-    std::getline(infile, cust.email);
-    std::getline(infile, cust.phone);
-
-    int numPurchases = 0;
-    infile >> numPurchases;
-    infile.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Ignore the newline character after numPurchases
-
-    for (int j = 0; j < numPurchases; ++j)
-    {
-      Purchase purchase;
-      std::getline(infile >> std::ws, purchase.itemName); // Read and skip leading whitespaces
-      infile >> purchase.quantity >> purchase.price;
-      infile.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Ignore the newline character after reading purchase.quantity
-      cust.purchases.push_back(purchase);
-    }
-
-    customers.push_back(cust);
+    return EvalResult();
   }
 
   if (load_what == "employee")
   {
-    std::cout << "Employees:" << std::endl;
-    for (const auto &emp : employees)
+    std::cout << "Employees:\n";
+    for (size_t i = 0; i < db->employee_count(); ++i)
     {
-      std::cout << emp.name << " < " << emp.email << " > "
-                << " Phone: " << emp.phone << "  Salary: $" << emp.salary << std::endl;
+      show_employee(db->employee(i));
     }
   }
   else if (load_what == "customer")
   {
-      if(customers.size() > 0){
-          std::cout << "\nCustomers:" << std::endl;
-          for (int i = 0; i < customers.size(); ++i)
+      // only the names are read
+      if(db->customer_count() > 0){
+          std::cout << "\nCustomers:\n";
+          for (size_t i = 0; i < db->customer_count(); ++i)
           {
-              std::cout << i + 1 << "." << customers[i].name << std::endl;
+              std::cout << i + 1 << "." << db->customer_name(i) << "\n";
           }
       } else{
-          std::cout << "Error: No Customers." << std::endl;
+          std::cout << "Error: No Customers.\n";
       }
   }
   else if (load_what == "customer_purchase")
   {
-      if(customers.size() > 0){
+      if(db->customer_count() > 0){
           if (customer_number == "")
           {
               std::cerr << "Invalid Input" << std::endl;
           }else {
-              EvalResult cust_eval = env->get(customer_number);
-              int cust_num = cust_eval.as_integer();
+              EvalResult cust_eval = customer_var.eval(env);
+              long long cust_num = cust_eval.as_integer();
 
-              const Customer &selectedCustomer = customers[cust_num - 1];
+              if (cust_num <= 0 || cust_num > db->customer_count())
+              {
+                  std::cerr << "Invalid Customer Number: " << cust_num << std::endl;
+                  return EvalResult();
+              }
+              Customer selectedCustomer = db->customer(cust_num - 1);
+              std::vector<Purchase> purchases;
+              db->purchases(cust_num - 1, purchases);
 
-              std::cout << selectedCustomer.name << " < " << selectedCustomer.email << " > Phone: " << selectedCustomer.phone << std::endl;
+              std::cout << selectedCustomer.name << " < " << selectedCustomer.email << " > Phone: " << selectedCustomer.phone << "\n";
 
-              std::cout << "Order History " << std::endl;
-              std::cout << "Item             Price      Quantity     Total" << std::endl;
+              std::cout << "Order History \n";
+              std::cout << "Item             Price      Quantity     Total\n";
 
-              for (const auto &purchase : selectedCustomer.purchases)
+              for (const auto &purchase : purchases)
               {
-                  std::cout << purchase.itemName << "     $" << purchase.price << "    " << purchase.quantity << "     $" << purchase.quantity * purchase.price << std::endl;
+                  std::cout << purchase.itemName << "     $" << purchase.price.to_string() << "    " << purchase.quantity << "     $";
+                  show_total(purchase);
+                  std::cout << "\n";
               }
           }
       } else{
-          std::cout << "Error: No Customers." << std::endl;
+          std::cout << "Error: No Customers.\n";
       }
 
   }
@@ -1481,30 +2025,40 @@ void Load_File::print(int indent) const
 }
 
 Write_File::Write_File(const Lexer_Token &file_name, const std::string &write_type, const std::string &customer_number, const std::vector<Lexer_Token> &variables)
-    : name_array(file_name), write_type(write_type), customer_number(customer_number), variables(variables)
+    : name_array(file_name), write_type(write_type), customer_number(customer_number), variables(variables),
+      file_var(file_name), customer_var(Lexer_Token(ID, this->customer_number, file_name.line, file_name.col))
 {
-  // Additional initialization, if needed
+  for (const Lexer_Token &var : variables)
+  {
+    vars.push_back(Variable(var));
+  }
 }
 
 EvalResult Write_File::eval(Ref_Env *env)
 {
   // Assuming the name_array contains the name of the variable to be written
-  EvalResult var_val = env->get(name_array.lexeme);
+  EvalResult var_val = file_var.eval(env);
 
   std::string filename = var_val.as_string();
 
-  // std::cout << "Writing data for " << var_val.as_string() << ":" << std::endl;
-  // std::cout << "Write Type " << write_type << std::endl;
+  // records are added to the DB as it is in the file
+  Company_DB *db = Company_DB::open(filename);
+  if (not db)
+  {
+    std::cerr << "Error reading the data." << std::endl;
+    return EvalResult();
+  }
 
   int i = 0;
+  bool written = true;
   if (write_type == "employee")
   {
-    std::string name = env->get(this->variables[i].lexeme).as_string();
-    std::string email = env->get(this->variables[i + 1].lexeme).as_string();
-    std::string phone = env->get(this->variables[i + 2].lexeme).as_string();
-    double salary = env->get(this->variables[i + 3].lexeme).as_integer();
+    std::string name = vars[i].eval(env).as_string();
+    std::string email = vars[i + 1].eval(env).as_string();
+    std::string phone = vars[i + 2].eval(env).as_string();
+    Decimal salary = money_of(vars[i + 3].eval(env));
 
-    std::cout << "salary " << salary << std::endl;
+    std::cout << "salary " << salary.to_string() << "\n";
 
     Employee emp;
     emp.name = name;
@@ -1512,22 +2066,20 @@ EvalResult Write_File::eval(Ref_Env *env)
     emp.phone = phone;
     emp.salary = salary;
 
-    // Append the new employee to the vector
-    employees.push_back(emp);
+    written = db->add_employee(emp);
   }
   else if (write_type == "customer")
   {
-    std::string name = env->get(this->variables[i].lexeme).as_string();
-    std::string email = env->get(this->variables[i + 1].lexeme).as_string();
-    std::string phone = env->get(this->variables[i + 2].lexeme).as_string();
+    std::string name = vars[i].eval(env).as_string();
+    std::string email = vars[i + 1].eval(env).as_string();
+    std::string phone = vars[i + 2].eval(env).as_string();
 
     Customer customer;
     customer.name = name;
     customer.email = email;
     customer.phone = phone;
 
-    // Append the new employee to the vector
-    customers.push_back(customer);
+    written = db->add_customer(customer);
   }else if (write_type == "customer_purchase")
   {
       if (customer_number == "")
@@ -1536,96 +2088,257 @@ EvalResult Write_File::eval(Ref_Env *env)
       }
       else
       {
-          // std::cout << "Debug: customer_number value: " << env->get(customer_number).as_integer() << std::endl;
-
-          int cust_num = env->get(customer_number).as_integer();
-          // std::cout << "Debug: cust_num before check: " << cust_num << std::endl;
+          long long cust_num = customer_var.eval(env).as_integer();
 
-
-          if (cust_num <= 0 || cust_num > customers.size())
+          if (cust_num <= 0 || cust_num > db->customer_count())
           {
               std::cerr << "Invalid Customer Number: " << cust_num << std::endl;
           }
           else
           {
-              Customer &selectedCustomer = customers[cust_num - 1];
-              std::string item = env->get(this->variables[i].lexeme).as_string();
-              int quantity = env->get(this->variables[i + 1].lexeme).as_integer();
-              double cost = env->get(this->variables[i + 2].lexeme).as_integer();
+              std::string item = vars[i].eval(env).as_string();
+              long long quantity = vars[i + 1].eval(env).as_integer();
+              Decimal cost = money_of(vars[i + 2].eval(env));
 
               Purchase purchaseDetails;
               purchaseDetails.itemName = item;
               purchaseDetails.quantity = quantity;
               purchaseDetails.price = cost;
 
-              selectedCustomer.purchases.push_back(purchaseDetails);
+              written = db->add_purchase(cust_num, purchaseDetails);
           }
       }
   }
 
-    // std::cout << "Writing data for " << filename << ":" << std::endl;
-    std::string final_data = "";
-    if (employees.size() > 0)
+  if (not written)
+  {
+      std::cerr << "Failed to write to file: " << filename << std::endl;
+  }
+
+  return EvalResult(); // Return a placeholder result
+}
+
+void Write_File::print(int indent) const
+{
+    std::cout << "Writing Data To File" << std::endl;
+
+}
+
+Fetch_Record::Fetch_Record(const Lexer_Token &file_name, const std::string &table, const std::string &field,
+                           const Lexer_Token &key, const Lexer_Token *result)
+    : table(table), field(field), has_result(result != nullptr),
+      file_var(file_name), key_var(key), result_var(result ? *result : key)
+{
+}
+
+EvalResult Fetch_Record::eval(Ref_Env *env)
+{
+  std::string filename = file_var.eval(env).as_string();
+  std::string key = key_var.eval(env).as_string();
+
+  DB_Key index;
+  if (table == "employee" and field == "name")
+  {
+    index = EMPLOYEE_NAME_KEY;
+  }
+  else if (table == "employee" and field == "email")
+  {
+    index = EMPLOYEE_EMAIL_KEY;
+  }
+  else if (table == "customer" and field == "name")
+  {
+    index = CUSTOMER_NAME_KEY;
+  }
+  else if (table == "customer" and field == "email")
+  {
+    index = CUSTOMER_EMAIL_KEY;
+  }
+  else
+  {
+    std::cerr << "Invalid Fetch: " << table << " " << field << std::endl;
+    return EvalResult();
+  }
+
+  Company_DB *db = Company_DB::open(filename);
+  if (not db)
+  {
+    std::cerr << "Error reading the data." << std::endl;
+    return EvalResult();
+  }
+
+  // the records are found through the DB's hash indexes
+  std::vector<size_t> found;
+  if (db->exists())
+  {
+    db->find(index, key, found);
+  }
+  if (found.empty())
+  {
+    std::cout << "Error: No Match.\n";
+  }
+  for (size_t i : found)
+  {
+    if (table == "employee")
     {
-        final_data += std::to_string(employees.size()) + "\n";
-        for (const Employee &employee : employees)
-        {
-            final_data += employee.name + "\n";
-            final_data += employee.email + "\n";
-            final_data += employee.phone + "\n";
-            final_data += std::to_string(employee.salary) + "\n";
-        }
+      show_employee(db->employee(i));
     }
     else
     {
-        final_data += std::to_string(0) + "\n";
+      Customer customer = db->customer(i);
+      std::cout << i + 1 << "." << customer.name << " < " << customer.email << " > Phone: " << customer.phone << "\n";
     }
+  }
 
-    if (customers.size() > 0)
-    {
-        final_data += std::to_string(customers.size()) + "\n";
-        for (const Customer &customer : customers)
-        {
-            final_data += customer.name + "\n";
-            final_data += customer.email + "\n";
-            final_data += customer.phone + "\n";
-            const std::vector<Purchase> &purchases = customer.purchases;
-            if (purchases.size() > 0)
-            {
-                final_data += std::to_string(purchases.size()) + "\n";
-                for (const Purchase &purchase : purchases)
-                {
-                    final_data += purchase.itemName + "\n";
-                    final_data += std::to_string(purchase.quantity) + "\n";
-                    final_data += std::to_string(purchase.price) + "\n";
-                }
-            }
-            else
-            {
-                final_data += std::to_string(0) + "\n";
-            }
-        }
-    }
+  if (has_result)
+  {
+    EvalResult number;
+    number.set((long long)(found.empty() ? 0 : found[0] + 1));
+    result_var.set(env, number);
+  }
+  return EvalResult();
+}
 
-    try
+void Fetch_Record::print(int indent) const
+{
+  std::cout << std::setw(indent) << "";
+  std::cout << "Fetch Record" << std::endl;
+}
+
+// a total of money, which may have been too big to hold
+static void show_revenue(const Purchase_Totals &totals)
+{
+  if (totals.overflow)
+  {
+    std::cout << "(overflow)";
+  }
+  else
+  {
+    std::cout << "$" << totals.revenue.to_string();
+  }
+}
+
+// the number of items kept while finding the top ones; the top items are
+// exact unless there are more distinct items than this
+static const size_t report_item_slots = 4096;
+
+// Totals the purchases as a DB file is scanned, showing each customer's as
+// they go by if asked to.
+class Report_Visitor : public Purchase_Visitor
+{
+public:
+  Report_Visitor(bool show_customers, size_t item_slots)
+      : customers(0), items(item_slots), show_customers(show_customers), count_items(item_slots > 0)
+  {
+  }
+
+  void purchase(const Purchase &purchase) override
+  {
+    if (count_items)
     {
-        std::ofstream outFile(filename);
-        outFile << final_data;
-        outFile.close();
+      items.add(purchase);
     }
-    catch (std::exception &e)
+  }
+
+  void customer(size_t number, const Customer &customer, const Purchase_Totals &totals) override
+  {
+    customers++;
+    total.add(totals);
+    if (show_customers)
     {
-        std::cerr << "Failed to write to file: " << e.what() << std::endl;
+      std::cout << number << "." << customer.name << "     Purchases: " << totals.purchases
+                << "    Quantity: " << totals.quantity << "     Total: ";
+      show_revenue(totals);
+      std::cout << "\n";
     }
+  }
 
+  size_t customers;
+  Purchase_Totals total;
+  Top_Items items;
+
+private:
+  bool show_customers;
+  bool count_items;
+};
 
-    return EvalResult(); // Return a placeholder result
+Report_Purchases::Report_Purchases(const Lexer_Token &file_name, const std::string &report_what,
+                                   const Lexer_Token *count)
+    : report_what(report_what), count_is_var(count and count->tok == ID), count(10), file_var(file_name),
+      count_var(count ? *count : file_name)
+{
+  if (count and count->tok == INTLIT)
+  {
+    std::from_chars(count->lexeme.data(), count->lexeme.data() + count->lexeme.size(), this->count);
+  }
 }
 
-void Write_File::print(int indent) const
+EvalResult Report_Purchases::eval(Ref_Env *env)
 {
-    std::cout << "Writing Data To File" << std::endl;
+  std::string filename = file_var.eval(env).as_string();
+  if (report_what != "customer" and report_what != "total" and report_what != "item")
+  {
+    std::cerr << "Invalid Report: " << report_what << std::endl;
+    return EvalResult();
+  }
+  long long top = count_is_var ? count_var.eval(env).as_integer() : count;
+  if (top < 0)
+  {
+    top = 0;
+  }
+
+  if (report_what == "customer")
+  {
+    std::cout << "\nCustomer Totals\n";
+  }
+  size_t slots = report_what == "item" ? std::max<size_t>(report_item_slots, top) : 0;
+  Report_Visitor report(report_what == "customer", slots);
+  if (not Company_DB::scan(filename, report))
+  {
+    std::cerr << "Error reading the data." << std::endl;
+    return EvalResult();
+  }
+
+  if (report_what == "customer" and report.customers == 0)
+  {
+    std::cout << "Error: No Customers.\n";
+  }
+  else if (report_what == "total")
+  {
+    std::cout << "Customers: " << report.customers << "\n";
+    std::cout << "Purchases: " << report.total.purchases << "\n";
+    std::cout << "Quantity: " << report.total.quantity << "\n";
+    std::cout << "Revenue: ";
+    show_revenue(report.total);
+    std::cout << "\n";
+  }
+  else if (report_what == "item")
+  {
+    std::vector<Top_Items::Item> items;
+    report.items.top(top, items);
+    if (items.empty())
+    {
+      std::cout << "Error: No Purchases.\n";
+      return EvalResult();
+    }
+    std::cout << "Top Items\n";
+    for (size_t i = 0; i < items.size(); i++)
+    {
+      std::cout << i + 1 << "." << items[i].name << "     Quantity: " << items[i].totals.quantity << "     Total: ";
+      show_revenue(items[i].totals);
+      std::cout << "\n";
+    }
+    if (not report.items.exact())
+    {
+      std::cout << "(estimated: there are more than " << slots << " items)\n";
+    }
+  }
+  return EvalResult();
+}
 
+void Report_Purchases::print(int indent) const
+{
+  std::cout << std::setw(indent) << "";
+  std::cout << "Report Purchases" << std::endl;
 }
 
 Close_File::Close_File(const Lexer_Token &file_name)
@@ -1635,6 +2348,11 @@ Close_File::Close_File(const Lexer_Token &file_name)
 
 EvalResult Close_File::eval(Ref_Env *env)
 {
+    // fold the journals into the files before leaving
+    if (not Company_DB::compact_all())
+    {
+        std::cerr << "Failed to write to file" << std::endl;
+    }
     exit(0);
 }
 
@@ -1648,7 +2366,7 @@ Class_Declaration::Class_Declaration(const Lexer_Token &name)
 
 EvalResult Class_Declaration::eval(Ref_Env *env)
 {
-  std::string name = name_.lexeme;
+  std::string name(name_.lexeme);
 
   return EvalResult();
 }
@@ -2,28 +2,39 @@
 // Purpose: Class definitions for all of the elements of our parse tree.
 #ifndef PARSE_TREE_H
 #define PARSE_TREE_H
+#include <string>
 #include <vector>
+#include "arena.h"
+#include "bigint.h"
+#include "decimal.h"
 #include "lexer.h"
-#include "ref_env.h"
 
 // class prototype
 class Ref_Env;
 class Fun_Def;
 class Class_Def;
+class Compiler;
+class Chunk;
+class Scope;
 
+// Closures are reference counted like the boxed values below, and hold a
+// reference to the environment they were defined in.
 class Closure
 {
 public:
+  int refs;
   Fun_Def *fun;
   Ref_Env *env;
+  Chunk *code; // compiled body (only set by the VM)
 
   Closure(Fun_Def *fun, Ref_Env *env);
+  ~Closure();
 };
 
 //////////////////////////////////////////
 // Evaluation Results
 //////////////////////////////////////////
-enum EvalType
+enum EvalType : unsigned char
 {
   VOID,
   INTEGER,
@@ -32,44 +43,202 @@ enum EvalType
   BOOLEAN,
   FUNCTION,
   STRING,
-  VECTOR
+  VECTOR,
+  BIGINT,     // an integer too big for 64 bits (smaller ones are always INTEGER)
+  DECIMAL,    // a fixed point number with six decimal places, stored inline
+  TAIL_CALL   // (internal) a tail call is waiting to replace the current call
 };
+
+// Strings, arrays and big integers live in reference counted boxes on the
+// heap, so a result is a type tag plus one 8 byte payload and copies are
+// cheap.
+class Boxed_String
+{
+public:
+  Boxed_String(std::string value) : refs(1), value(std::move(value)) {}
+  int refs;
+  std::string value;
+};
+
+class Boxed_Array
+{
+public:
+  Boxed_Array(std::vector<long long> value) : refs(1), value(std::move(value)) {}
+  int refs;
+  std::vector<long long> value;
+};
+
+class Boxed_Big
+{
+public:
+  Boxed_Big(Big_Int value) : refs(1), value(std::move(value)) {}
+  int refs;
+  Big_Int value;
+};
+
 class EvalResult
 {
 public:
-  EvalResult();
+  EvalResult() : _type(VOID), _bits(0) {}
+  EvalResult(const EvalResult &other) : _type(other._type), _bits(other._bits) { retain(); }
+  EvalResult(EvalResult &&other) : _type(other._type), _bits(other._bits) { other._type = VOID; }
+  ~EvalResult() { release(); }
+
+  EvalResult &operator=(const EvalResult &other)
+  {
+    if (this != &other)
+    {
+      other.retain();
+      release();
+      _type = other._type;
+      _bits = other._bits;
+    }
+    return *this;
+  }
+
+  EvalResult &operator=(EvalResult &&other)
+  {
+    if (this != &other)
+    {
+      release();
+      _type = other._type;
+      _bits = other._bits;
+      other._type = VOID;
+    }
+    return *this;
+  }
 
   // set the type and zero the value
-  virtual void set_type(EvalType _type);
+  void set_type(EvalType _type)
+  {
+    release();
+    this->_type = _type;
+    _bits = 0;
+  }
 
   // set the value and infer the type
-  virtual void set(int _i);
-  virtual void set(double _d);
-  virtual void set(bool _b);
-  virtual void set(Closure *_fun);
-  virtual void set(std::string _b);
-  virtual void set(std::vector<int> _myarray);
-
-  // type coercion functions
-  virtual int as_integer();
-  virtual double as_real();
-  virtual bool as_bool();
-  virtual Closure *as_fun();
-  virtual std::string as_string();
-  virtual std::vector<int> as_array();
+  void set(long long _i) { release(); this->_i = _i; _type = INTEGER; }
+  void set(int _i) { set((long long)_i); }
+  void set(double _d) { release(); this->_d = _d; _type = REAL; }
+  void set(bool _b) { release(); _bits = 0; this->_b = _b; _type = BOOLEAN; }
+  void set(Closure *_fun) { release(); this->_fun = _fun; _type = FUNCTION; }  // adopts a new closure
+  void set(std::string _str) { release(); this->_str = new Boxed_String(std::move(_str)); _type = STRING; }
+  void set(std::vector<long long> _myarray) { release(); this->_myarray = new Boxed_Array(std::move(_myarray)); _type = VECTOR; }
+
+  void set(Decimal _dec) { release(); this->_i = _dec.units(); _type = DECIMAL; }
+
+  // big integers which fit in 64 bits are stored as an INTEGER
+  void set(Big_Int _big)
+  {
+    if (_big.fits())
+    {
+      set(_big.to_integer());
+    }
+    else
+    {
+      release();
+      this->_big = new Boxed_Big(std::move(_big));
+      _type = BIGINT;
+    }
+  }
+
+  // type coercion functions (big integers saturate to 64 bits)
+  long long as_integer() const
+  {
+    switch (_type)
+    {
+    case INTEGER: return _i;
+    case REAL: return (long long)_d;
+    case BOOLEAN: return _b;
+    case BIGINT: return _big->value.to_integer();
+    case DECIMAL: return as_decimal().to_integer();
+    default: return 0;
+    }
+  }
+
+  double as_real() const
+  {
+    switch (_type)
+    {
+    case REAL: return _d;
+    case INTEGER: return (double)_i;
+    case BOOLEAN: return _b;
+    case BIGINT: return _big->value.to_real();
+    case DECIMAL: return as_decimal().to_real();
+    default: return 0;
+    }
+  }
+
+  bool as_bool() const
+  {
+    switch (_type)
+    {
+    case BOOLEAN: return _b;
+    case INTEGER: return _i != 0;
+    case REAL: return _d != 0;
+    case BIGINT: return true;
+    case DECIMAL: return _i != 0;
+    default: return false;
+    }
+  }
+
+  Closure *as_fun() const { return _type == FUNCTION ? _fun : nullptr; }
+  const std::string &as_string() const { return _type == STRING ? _str->value : empty_string(); }
+  const Big_Int *as_big() const { return _type == BIGINT ? &_big->value : nullptr; }
+  Decimal as_decimal() const { return _type == DECIMAL ? Decimal::from_units(_i) : Decimal(); }
+  const std::vector<long long> &as_array() const { return _type == VECTOR ? _myarray->value : empty_array(); }
+
+  // the array itself (VECTOR only); every copy of the result shares it
+  std::vector<long long> &array() const { return _myarray->value; }
 
   // retrieve the type
-  virtual EvalType type();
+  EvalType type() const { return _type; }
 
 private:
-  int _i;                    // an integer
-  double _d;                 // a real number
-  bool _b;                   // a boolean value
-  EvalType _type;            // the type
-  Closure *_fun;             // a function definition
-  std::string _str;          // a string defination
-  std::vector<int> _myarray; // for an array or vector
-};
+  EvalType _type;              // the type
+  union
+  {
+    long long _i;              // a 64 bit integer (or a decimal's millionths)
+    double _d;                 // a real number
+    bool _b;                   // a boolean value
+    Closure *_fun;             // a function definition
+    Boxed_String *_str;        // a string defination
+    Boxed_Array *_myarray;     // for an array or vector
+    Boxed_Big *_big;           // a big integer
+    unsigned long long _bits;  // the raw payload, for copying
+  };
+
+  // reference counting for the boxed types
+  void retain() const
+  {
+    if (_type == STRING)
+      _str->refs++;
+    else if (_type == VECTOR)
+      _myarray->refs++;
+    else if (_type == FUNCTION)
+      _fun->refs++;
+    else if (_type == BIGINT)
+      _big->refs++;
+  }
+
+  void release()
+  {
+    if (_type == STRING and --_str->refs == 0)
+      delete _str;
+    else if (_type == VECTOR and --_myarray->refs == 0)
+      delete _myarray;
+    else if (_type == FUNCTION and --_fun->refs == 0)
+      delete _fun;
+    else if (_type == BIGINT and --_big->refs == 0)
+      delete _big;
+    _type = VOID;
+  }
+
+  static const std::string &empty_string();
+  static const std::vector<long long> &empty_array();
+};
+
+static_assert(sizeof(EvalResult) == 16, "EvalResult should be a tag and a payload");
 
 //////////////////////////////////////////
 // Pure Virtual Base Class
@@ -78,9 +247,31 @@ private:
 class Parse_Tree
 {
 public:
+  // nodes are allocated in, and released with, the parser's arena
+  static void *operator new(size_t size, Arena &arena);
+  static void operator delete(void *ptr, Arena &arena);
+  static void operator delete(void *ptr);
+
   virtual ~Parse_Tree();
   virtual EvalResult eval(Ref_Env *env) = 0;
   virtual void print(int indent) const = 0; // <- =0 syntax indicates pure virtual
+
+  // lower the node to bytecode (default: let the VM call eval)
+  virtual void compile(Compiler *c);
+
+  // record the names this statement binds in scope (default: none)
+  virtual void declare(Scope *scope);
+
+  // resolve the variables used by the node (default: none)
+  virtual void resolve(Scope *scope);
+
+  // mark the calls in tail position of a function body in scope. guards are
+  // conditions which must all be false for the call to be a tail call, and
+  // discard is true when the function's value is not the call's (default: none)
+  virtual void mark_tail_calls(Scope *scope, const std::vector<Parse_Tree *> &guards, bool discard);
+
+  // simplify the node, returning the node to use in its place (default: this)
+  virtual Parse_Tree *optimize(Arena &arena);
 };
 
 //////////////////////////////////////////
@@ -96,6 +287,10 @@ public:
   virtual Parse_Tree *child() const;
   virtual void child(Parse_Tree *_child);
 
+  // resolve the child
+  virtual void resolve(Scope *scope);
+  virtual Parse_Tree *optimize(Arena &arena);
+
 private:
   Parse_Tree *_child;
 };
@@ -112,6 +307,10 @@ public:
   virtual Parse_Tree *right() const;
   virtual void right(Parse_Tree *_right);
 
+  // resolve the children
+  virtual void resolve(Scope *scope);
+  virtual Parse_Tree *optimize(Arena &arena);
+
 private:
   Parse_Tree *_left;
   Parse_Tree *_right;
@@ -130,6 +329,10 @@ public:
   virtual std::vector<Parse_Tree *>::const_iterator begin() const;
   virtual std::vector<Parse_Tree *>::const_iterator end() const;
 
+  // resolve the children
+  virtual void resolve(Scope *scope);
+  virtual Parse_Tree *optimize(Arena &arena);
+
 private:
   std::vector<Parse_Tree *> _children;
 };
@@ -142,6 +345,9 @@ class Program : public NaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual void declare(Scope *scope);
+  virtual void mark_tail_calls(Scope *scope, const std::vector<Parse_Tree *> &guards, bool discard);
 };
 
 class Add : public BinaryOp
@@ -149,6 +355,11 @@ class Add : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Subtract : public BinaryOp
@@ -156,6 +367,11 @@ class Subtract : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Multiply : public BinaryOp
@@ -163,6 +379,11 @@ class Multiply : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Divide : public BinaryOp
@@ -170,6 +391,11 @@ class Divide : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Mod : public BinaryOp
@@ -177,6 +403,11 @@ class Mod : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Power : public BinaryOp
@@ -184,6 +415,11 @@ class Power : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Negation : public UnaryOp
@@ -191,6 +427,40 @@ class Negation : public UnaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to an already evaluated operand
+  static EvalResult apply(const EvalResult &c);
+};
+
+// a value worked out ahead of time by the optimizer
+class Constant : public Parse_Tree
+{
+public:
+  Constant(const EvalResult &value);
+
+  virtual EvalResult eval(Ref_Env *env);
+  virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+
+  // the value
+  const EvalResult &value() const;
+
+private:
+  EvalResult _value;
+};
+
+// x ^ 2, strength reduced from Power by the optimizer
+class Square : public UnaryOp
+{
+public:
+  virtual EvalResult eval(Ref_Env *env);
+  virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+
+  // apply the operator to an already evaluated operand
+  static EvalResult apply(const EvalResult &c);
 };
 
 class Literal : public Parse_Tree
@@ -200,6 +470,8 @@ public:
 
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
 
 private:
   Lexer_Token _tok;
@@ -212,12 +484,28 @@ public:
 
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual void resolve(Scope *scope);
 
   virtual void set(Ref_Env *env, EvalResult value);
   virtual std::string name() const;
 
+  // the variable's storage, or nullptr if it is unbound
+  EvalResult *lookup(Ref_Env *env);
+
+  // the resolved location (slot is -1 if unresolved)
+  int depth() const;
+  int slot() const;
+
+  // true if the slot shadows an outer binding, which is used until the
+  // slot is first assigned
+  bool shadows() const;
+
 private:
   Lexer_Token _tok;
+  int _depth;
+  int _slot;
+  bool _shadows;
 };
 
 class Assignment : public BinaryOp
@@ -225,6 +513,8 @@ class Assignment : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual void declare(Scope *scope);
 };
 
 class Display : public UnaryOp
@@ -232,6 +522,10 @@ class Display : public UnaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+
+  // print an already evaluated value
+  static void show(const EvalResult &value);
 };
 
 class Input : public UnaryOp
@@ -239,6 +533,7 @@ class Input : public UnaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void declare(Scope *scope);
 };
 
 class Record_Instantiation : public UnaryOp
@@ -265,6 +560,9 @@ class Branch : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual void declare(Scope *scope);
+  virtual void mark_tail_calls(Scope *scope, const std::vector<Parse_Tree *> &guards, bool discard);
 };
 
 class Loop : public BinaryOp
@@ -272,6 +570,8 @@ class Loop : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual void declare(Scope *scope);
 };
 
 class Equal : public BinaryOp
@@ -279,6 +579,11 @@ class Equal : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Not_Equal : public BinaryOp
@@ -286,6 +591,11 @@ class Not_Equal : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Greater : public BinaryOp
@@ -293,6 +603,11 @@ class Greater : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Less : public BinaryOp
@@ -300,6 +615,11 @@ class Less : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Less_or_Equal : public BinaryOp
@@ -307,6 +627,11 @@ class Less_or_Equal : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Greater_or_Equal : public BinaryOp
@@ -314,6 +639,11 @@ class Greater_or_Equal : public BinaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual Parse_Tree *optimize(Arena &arena);
+
+  // apply the operator to already evaluated operands
+  static EvalResult apply(const EvalResult &l, const EvalResult &r);
 };
 
 class Record_Access : public BinaryOp
@@ -328,25 +658,47 @@ class Parse_List : public NaryOp
 public:
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
 };
 
 class Fun_Def : public BinaryOp
 {
 public:
   Fun_Def(const Lexer_Token &tok);
+  virtual ~Fun_Def();
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual void declare(Scope *scope);
+  virtual void resolve(Scope *scope);
   virtual std::string name() const;
 
+  // the scope of the function body (nullptr until resolved)
+  Scope *scope() const;
+
 private:
   Variable var;
+  Scope *_scope;
 };
 
 class Fun_Call : public BinaryOp
 {
 public:
+  Fun_Call();
   virtual EvalResult eval(Ref_Env *env);
   virtual void print(int indent) const;
+  virtual void compile(Compiler *c);
+  virtual void mark_tail_calls(Scope *scope, const std::vector<Parse_Tree *> &guards, bool discard);
+
+private:
+  // a call in tail position replaces the caller's activation rather than
+  // nesting inside it, provided none of the guards hold
+  bool _tail;
+  bool _discard;
+  std::vector<Parse_Tree *> _guards;
+
+  // true if none of the guards hold in env
+  bool unguarded(Ref_Env *env);
 };
 
 class Array_Declaration : public Parse_Tree
@@ -355,11 +707,15 @@ public:
   Array_Declaration(const Lexer_Token &type, const Lexer_Token &bound, const Lexer_Token &name);
   EvalResult eval(Ref_Env *env) override;
   void print(int indent) const override;
+  void declare(Scope *scope) override;
+  void resolve(Scope *scope) override;
 
 private:
   Lexer_Token type_;
   Lexer_Token bound_;
   Lexer_Token name_;
+  Variable bound_var;
+  Variable name_var;
 };
 
 
@@ -375,10 +731,13 @@ public:
     Array_Access(const Lexer_Token& name_array, Lexer_Token &index);
     virtual EvalResult eval(Ref_Env* env) override;
     void print(int indent) const override;
+    void resolve(Scope *scope) override;
 
 private:
     Lexer_Token name_array;
     Lexer_Token index_;
+    Variable array_var;
+    Variable index_var;
 };
 
 
@@ -388,11 +747,15 @@ public:
   Array_Update(const Lexer_Token &name_array, Lexer_Token &index, Lexer_Token &update_value);
   virtual EvalResult eval(Ref_Env *env) override;
   void print(int indent) const override;
+  void resolve(Scope *scope) override;
 
 private:
   Lexer_Token name_array;
   Lexer_Token index_;
   Lexer_Token update_value_;
+  Variable array_var;
+  Variable index_var;
+  Variable value_var;
 };
 
 class Array_Size : public Parse_Tree
@@ -401,9 +764,11 @@ public:
   Array_Size(const Lexer_Token &name_array);
   virtual EvalResult eval(Ref_Env *env) override;
   void print(int indent) const override;
+  void resolve(Scope *scope) override;
 
 private:
   Lexer_Token name_array;
+  Variable array_var;
 };
 
 
@@ -414,11 +779,14 @@ public:
   Load_File(const Lexer_Token &name_array, const std::string &load_what, std::string &customer_number);
   virtual EvalResult eval(Ref_Env *env) override;
   void print(int indent) const override;
+  void resolve(Scope *scope) override;
 
 private:
   Lexer_Token name_array;
   std::string load_what;
   std::string customer_number;
+  Variable file_var;
+  Variable customer_var;
 };
 
 class Write_File : public Parse_Tree
@@ -427,16 +795,62 @@ public:
     Write_File(const Lexer_Token &name_array, const std::string &write_type, const std::string &customer_number, const std::vector<Lexer_Token> &variables);
     virtual EvalResult eval(Ref_Env *env) override;
     void print(int indent) const override;
+    void resolve(Scope *scope) override;
 
 private:
     Lexer_Token name_array;
     std::string write_type;
     std::string customer_number;
     std::vector<Lexer_Token> variables;
+    Variable file_var;
+    Variable customer_var;
+    std::vector<Variable> vars;
 };
 
 
 
+// fetch file employee|customer name|email Key [Result]
+// shows the records whose name or email is Key, and sets Result to the
+// number of the first of them (0 if there is none)
+class Fetch_Record : public Parse_Tree
+{
+public:
+  Fetch_Record(const Lexer_Token &file_name, const std::string &table, const std::string &field,
+               const Lexer_Token &key, const Lexer_Token *result);
+  virtual EvalResult eval(Ref_Env *env) override;
+  void print(int indent) const override;
+  void declare(Scope *scope) override;
+  void resolve(Scope *scope) override;
+
+private:
+  std::string table;
+  std::string field;
+  bool has_result;
+  Variable file_var;
+  Variable key_var;
+  Variable result_var;
+};
+
+// report file customer|total|item [Count]
+// totals the purchases in the file in one pass without loading it: by
+// customer, over all of them, or by item for the Count (default 10) items
+// with the most revenue
+class Report_Purchases : public Parse_Tree
+{
+public:
+  Report_Purchases(const Lexer_Token &file_name, const std::string &report_what, const Lexer_Token *count);
+  virtual EvalResult eval(Ref_Env *env) override;
+  void print(int indent) const override;
+  void resolve(Scope *scope) override;
+
+private:
+  std::string report_what;
+  bool count_is_var;
+  long long count;  // if it is not a variable
+  Variable file_var;
+  Variable count_var;
+};
+
 class Close_File : public Parse_Tree
 {
 public:
@@ -461,4 +875,7 @@ private:
 };
 
 
+// simplify a program (calc -O), returning the tree to run in its place
+Parse_Tree *optimize(Parse_Tree *program, Arena &arena);
+
 #endif
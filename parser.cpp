@@ -4,11 +4,22 @@
 #include <iostream>
 
 // constructor
-Parser::Parser(Lexer *_lex)
+Parser::Parser(Lexer *_lex) : Parser(_lex, nullptr)
+{
+  // nothing to do here
+}
+
+// build the tree in a longer lived arena (e.g. the REPL's session)
+Parser::Parser(Lexer *_lex, Arena *_arena)
 {
   // get the lexer
   this->_lex = _lex;
 
+  // the tree and its lexemes live in the arena
+  this->_arena = _arena ? _arena : &_own_arena;
+  _lex->arena(this->_arena);
+  _defines_functions = false;
+
   // get the first token
   _lex->next();
 }
@@ -16,6 +27,9 @@ Parser::Parser(Lexer *_lex)
 // attempt to parse the program which the lexer provides
 Parse_Tree *Parser::parse() { return parse_Program(); }
 
+// true if the tree holds a function definition
+bool Parser::defines_functions() const { return _defines_functions; }
+
 //////////////////////////////////////////
 // Lexer Convenience Functions
 //////////////////////////////////////////
@@ -60,7 +74,7 @@ Lexer_Token Parser::consume()
 */
 Parse_Tree *Parser::parse_Program()
 {
-  Program *result = new Program();
+  Program *result = new (*_arena) Program();
 
   do
   {
@@ -216,6 +230,14 @@ Parse_Tree *Parser::parse_Statement_Body()
   {
     result = close_file();
   }
+  else if (has(FETCH))
+  {
+    result = parse_fetch();
+  }
+  else if (has(REPORT))
+  {
+    result = parse_report();
+  }
   else if (not has(NEWLINE))
   {
     result = parse_Expression();
@@ -240,7 +262,7 @@ Parse_Tree *Parser::parse_Statement2(Parse_Tree *left)
   if(has(EQUAL)) {
     // this an assignment
     consume();
-    Assignment *result = new Assignment();
+    Assignment *result = new (*_arena) Assignment();
     result->left(left);
     result->right(parse_Expression());
     return result;
@@ -266,7 +288,7 @@ Parse_Tree *Parser::parse_Statement2(Parse_Tree *left)
   {
     // this an assignment
     consume();
-    Assignment *result = new Assignment();
+    Assignment *result = new (*_arena) Assignment();
     result->left(left);
     result->right(parse_Statement3(result));
     return result;
@@ -309,7 +331,7 @@ Parse_Tree *Parser::parse_IO_Operation()
   if (has(DISPLAY))
   {
     consume();
-    Display *result = new Display();
+    Display *result = new (*_arena) Display();
     result->child(parse_Expression());
     return result;
   }
@@ -317,7 +339,7 @@ Parse_Tree *Parser::parse_IO_Operation()
   must_be(INPUT);
   consume();
   must_be(ID);
-  Input *result = new Input();
+  Input *result = new (*_arena) Input();
   result->child(parse_Number());
   return result;
 }
@@ -328,7 +350,7 @@ Parse_Tree *Parser::parse_Branch()
 {
   must_be(IF);
   consume();
-  Branch *result = new Branch();
+  Branch *result = new (*_arena) Branch();
   result->left(parse_Condition());
   must_be(NEWLINE);
   consume();
@@ -346,7 +368,7 @@ Parse_Tree *Parser::parse_Loop()
 {
   must_be(WHILE);
   consume();
-  Loop *result = new Loop();
+  Loop *result = new (*_arena) Loop();
   result->left(parse_Condition());
   must_be(NEWLINE);
   consume();
@@ -380,7 +402,8 @@ Parse_Tree *Parser::parse_Fun_Def()
   must_be(FUN);
   consume();
 
-  Fun_Def *result = new Fun_Def(id);
+  Fun_Def *result = new (*_arena) Fun_Def(id);
+  _defines_functions = true;
   result->left(plist);
   result->right(program);
   return (Parse_Tree *)result;
@@ -395,7 +418,7 @@ Parse_Tree *Parser::parse_Fun_Def()
 */
 Parse_Tree *Parser::parse_Param_List()
 {
-  Parse_List *result = new Parse_List();
+  Parse_List *result = new (*_arena) Parse_List();
   bool done;
 
   // check for an empty list
@@ -407,7 +430,7 @@ Parse_Tree *Parser::parse_Param_List()
   do
   {
     must_be(ID);
-    result->add(new Variable(consume()));
+    result->add(new (*_arena) Variable(consume()));
     if (has(COMMA))
     {
       done = false;
@@ -441,7 +464,7 @@ Parse_Tree *Parser::parse_Expression2(Parse_Tree *left)
   if (has(PLUS))
   {
     consume();
-    Add *result = new Add();
+    Add *result = new (*_arena) Add();
     result->left(left);
     result->right(parse_Term());
     return parse_Expression2(result);
@@ -449,7 +472,7 @@ Parse_Tree *Parser::parse_Expression2(Parse_Tree *left)
   else if (has(MINUS))
   {
     consume();
-    Subtract *result = new Subtract();
+    Subtract *result = new (*_arena) Subtract();
     result->left(left);
     result->right(parse_Term());
     return parse_Expression2(result);
@@ -478,7 +501,7 @@ Parse_Tree *Parser::parse_Term2(Parse_Tree *left)
   if (has(TIMES))
   {
     consume();
-    Multiply *result = new Multiply();
+    Multiply *result = new (*_arena) Multiply();
     result->left(left);
     result->right(parse_Factor());
     return parse_Term2(result);
@@ -486,7 +509,7 @@ Parse_Tree *Parser::parse_Term2(Parse_Tree *left)
   else if (has(DIVIDE))
   {
     consume();
-    Divide *result = new Divide();
+    Divide *result = new (*_arena) Divide();
     result->left(left);
     result->right(parse_Factor());
     return parse_Term2(result);
@@ -494,7 +517,7 @@ Parse_Tree *Parser::parse_Term2(Parse_Tree *left)
   else if (has(MOD))
   {
     consume();
-    Mod *result = new Mod();
+    Mod *result = new (*_arena) Mod();
     result->left(left);
     result->right(parse_Factor());
     return parse_Term2(result);
@@ -522,7 +545,7 @@ Parse_Tree *Parser::parse_Factor2(Parse_Tree *left)
   if (has(POW))
   {
     consume();
-    Power *result = new Power();
+    Power *result = new (*_arena) Power();
     result->left(left);
     result->right(parse_Factor());
     return result;
@@ -549,7 +572,7 @@ Parse_Tree *Parser::parse_Base()
   else if (has(MINUS))
   {
     consume();
-    Negation *result = new Negation();
+    Negation *result = new (*_arena) Negation();
     result->child(parse_Expression());
     return result;
   }
@@ -566,15 +589,15 @@ Parse_Tree *Parser::parse_Number()
 {
   if (has(INTLIT))
   {
-    return new Literal(consume());
+    return new (*_arena) Literal(consume());
   }
   else if (has(REALLIT))
   {
-    return new Literal(consume());
+    return new (*_arena) Literal(consume());
   }
   else if (has(STRLIT))
   {
-    return new Literal(consume());
+    return new (*_arena) Literal(consume());
   }
   else
   {
@@ -592,7 +615,7 @@ Parse_Tree *Parser::parse_Record_Decl()
   {
     consume();
     must_be(ID);
-    Record_Declaration *result = new Record_Declaration(consume());
+    Record_Declaration *result = new (*_arena) Record_Declaration(consume());
     must_be(NEWLINE);
     consume();
     result->add(parse_Field_List(result));
@@ -630,7 +653,7 @@ Parse_Tree *Parser::parse_Field(Record_Declaration *decl)
   must_be(FIELD);
   consume();
   must_be(ID);
-  result = new Variable(consume());
+  result = new (*_arena) Variable(consume());
   must_be(NEWLINE);
   consume();
   return result;
@@ -645,7 +668,7 @@ Parse_Tree *Parser::parse_Record_Inst()
   must_be(NEW);
   consume();
   must_be(ID);
-  result = new Variable(consume());
+  result = new (*_arena) Variable(consume());
   return result;
 }
 
@@ -674,32 +697,32 @@ Parse_Tree *Parser::parse_Condition2(Parse_Tree *left)
   if (has(EQUAL))
   {
     consume();
-    result = new Equal();
+    result = new (*_arena) Equal();
   }
   else if (has(NE))
   {
     consume();
-    result = new Not_Equal();
+    result = new (*_arena) Not_Equal();
   }
   else if (has(LT))
   {
     consume();
-    result = new Less();
+    result = new (*_arena) Less();
   }
   else if (has(GT))
   {
     consume();
-    result = new Greater();
+    result = new (*_arena) Greater();
   }
   else if (has(LTE))
   {
     consume();
-    result = new Less_or_Equal();
+    result = new (*_arena) Less_or_Equal();
   }
   else if (must_be(GTE))
   {
     consume();
-    result = new Greater_or_Equal();
+    result = new (*_arena) Greater_or_Equal();
   }
 
   result->left(left);
@@ -714,7 +737,7 @@ Parse_Tree *Parser::parse_Ref()
 {
   must_be(ID);
   Lexer_Token lx = _lex->cur();
-  Parse_Tree *left = new Variable(consume());
+  Parse_Tree *left = new (*_arena) Variable(consume());
   if (has(DOT))
   {
     consume();
@@ -723,7 +746,7 @@ Parse_Tree *Parser::parse_Ref()
       consume();
       if (has(ID) or has(INTLIT))
       {
-        ArrayAssignment *result = new ArrayAssignment();
+        ArrayAssignment *result = new (*_arena) ArrayAssignment();
         result->left(left);
         result->right(parse_Statement3(result));
         return result;
@@ -737,14 +760,14 @@ Parse_Tree *Parser::parse_Ref()
       {
         Lexer_Token arr_index = _lex->cur();
         consume();
-        Array_Access *result = new Array_Access(lx, arr_index);
+        Array_Access *result = new (*_arena) Array_Access(lx, arr_index);
         return result;
       }
     }
     else if (has(SIZE))
     {
       consume();
-      Array_Size *result = new Array_Size(lx);
+      Array_Size *result = new (*_arena) Array_Size(lx);
       return result;
     }
 
@@ -757,7 +780,7 @@ Parse_Tree *Parser::parse_Ref()
         consume();
         Lexer_Token update_value = _lex->cur();
         consume();
-        Array_Update *result = new Array_Update(lx, arr_index, update_value);
+        Array_Update *result = new (*_arena) Array_Update(lx, arr_index, update_value);
         return result;
       }
     }
@@ -771,9 +794,9 @@ Parse_Tree *Parser::parse_Ref2(Parse_Tree *left)
   {
     consume();
     must_be(ID);
-    Record_Access *result = new Record_Access();
+    Record_Access *result = new (*_arena) Record_Access();
     result->left(left);
-    result->right(new Variable(consume()));
+    result->right(new (*_arena) Variable(consume()));
 
     return parse_Ref2(result);
   }
@@ -781,7 +804,7 @@ Parse_Tree *Parser::parse_Ref2(Parse_Tree *left)
   {
     consume();
     Parse_Tree *alist = parse_Arg_List();
-    Fun_Call *result = new Fun_Call();
+    Fun_Call *result = new (*_arena) Fun_Call();
     result->left(left);
     result->right(alist);
     must_be(RPAREN);
@@ -802,7 +825,7 @@ Parse_Tree *Parser::parse_Ref2(Parse_Tree *left)
 */
 Parse_Tree *Parser::parse_Arg_List()
 {
-  Parse_List *result = new Parse_List();
+  Parse_List *result = new (*_arena) Parse_List();
   bool done;
 
   // check for an empty list
@@ -847,7 +870,7 @@ Parse_Tree *Parser::parse_Array_Decl()
   consume();
   Lexer_Token arrayName = consume();
 
-  return new Array_Declaration(typeToken, array_bound, arrayName);
+  return new (*_arena) Array_Declaration(typeToken, array_bound, arrayName);
 }
 
 Parse_Tree *Parser::parse_file_load()
@@ -856,15 +879,15 @@ Parse_Tree *Parser::parse_file_load()
   consume();
   Lexer_Token file_name = _lex->cur();
   consume();
-  std::string load_what = _lex->cur().lexeme.c_str();
+  std::string load_what = std::string(_lex->cur().lexeme);
   consume();
   std::string customer_number = "";
   if (load_what == "customer_purchase")
   {
-    customer_number = _lex->cur().lexeme.c_str();
+    customer_number = std::string(_lex->cur().lexeme);
     consume();
   }
-  return new Load_File(file_name, load_what, customer_number);
+  return new (*_arena) Load_File(file_name, load_what, customer_number);
 }
 
 Parse_Tree *Parser::parse_File_Write()
@@ -874,12 +897,12 @@ Parse_Tree *Parser::parse_File_Write()
   consume();
   Lexer_Token file_name = _lex->cur();
   consume();
-  std::string write_type = _lex->cur().lexeme.c_str();
+  std::string write_type = std::string(_lex->cur().lexeme);
   consume();
   std::string customer_number = "";
   if (write_type == "customer_purchase")
   {
-    customer_number = _lex->cur().lexeme.c_str();
+    customer_number = std::string(_lex->cur().lexeme);
     consume();
   }
   // Parse a list of variables
@@ -889,17 +912,55 @@ Parse_Tree *Parser::parse_File_Write()
     variables.push_back(_lex->cur());
     consume();
   }
-  return new Write_File(file_name, write_type, customer_number, variables);
+  return new (*_arena) Write_File(file_name, write_type, customer_number, variables);
 }
 
 
+// fetch file employee|customer name|email Key [Result]
+Parse_Tree *Parser::parse_fetch()
+{
+  must_be(FETCH);
+  consume();
+  Lexer_Token file_name = _lex->cur();
+  consume();
+  std::string table = std::string(_lex->cur().lexeme);
+  consume();
+  std::string field = std::string(_lex->cur().lexeme);
+  consume();
+  must_be(ID);
+  Lexer_Token key = consume();
+  if (has(ID))
+  {
+    Lexer_Token result = consume();
+    return new (*_arena) Fetch_Record(file_name, table, field, key, &result);
+  }
+  return new (*_arena) Fetch_Record(file_name, table, field, key, nullptr);
+}
+
+// report file customer|total|item [Count]
+Parse_Tree *Parser::parse_report()
+{
+  must_be(REPORT);
+  consume();
+  Lexer_Token file_name = _lex->cur();
+  consume();
+  std::string report_what = std::string(_lex->cur().lexeme);
+  consume();
+  if (has(ID) or has(INTLIT))
+  {
+    Lexer_Token count = consume();
+    return new (*_arena) Report_Purchases(file_name, report_what, &count);
+  }
+  return new (*_arena) Report_Purchases(file_name, report_what, nullptr);
+}
+
 Parse_Tree *Parser::close_file()
 {
   must_be(CLOSE);
   consume();
   Lexer_Token file_name = _lex->cur();
   consume();
-  return new Close_File(file_name);
+  return new (*_arena) Close_File(file_name);
 }
 
 // < Class-Decl > ::= CLASS ID < Inheritance > NEWLINE < Program > END CLASS
@@ -930,6 +991,6 @@ Parse_Tree *Parser::parse_Class_Decl()
   must_be(CLASS);
   consume();
 
-  Class_Declaration *result = new Class_Declaration(class_name_tok);
+  Class_Declaration *result = new (*_arena) Class_Declaration(class_name_tok);
   return (Parse_Tree *)result;
 }
\ No newline at end of file
@@ -8,12 +8,20 @@ class Parser
 public:
   // constructor
   Parser(Lexer *_lex);
+  Parser(Lexer *_lex, Arena *_arena);
 
   // attempt to parse the program which the lexer provides
   Parse_Tree *parse();
 
+  // true if the tree holds a function definition, whose closures may
+  // outlive the tree's other nodes
+  bool defines_functions() const;
+
 private:
   Lexer *_lex;
+  Arena _own_arena;
+  Arena *_arena;  // owns the parse tree
+  bool _defines_functions;
 
   //////////////////////////////////////////
   // Lexer Convenience Functions
@@ -64,6 +72,8 @@ private:
   Parse_Tree* parse_file_load();
   Parse_Tree* parse_File_Write();
   Parse_Tree* close_file();
+  Parse_Tree* parse_fetch();
+  Parse_Tree* parse_report();
   Parse_Tree* parse_Class_Decl();
   
 };
\ No newline at end of file
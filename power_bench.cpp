@@ -0,0 +1,41 @@
+// File: power_bench.cpp
+// Purpose: Compare the integer fast path of ^ against the pow() path it
+//          replaced, on the same small integer powers.
+#include <chrono>
+#include <iostream>
+#include "parse_tree.h"
+
+// time a million rounds of base ^ 0..exps, with the operands of the given type
+static void time_power(EvalType type, int exps)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  double total = 0;
+  for (int i = 0; i < 1000000; i++)
+  {
+    EvalResult base, exp;
+    int b = 2 + i % 5;
+    int e = i % exps;
+    if (type == INTEGER)
+    {
+      base.set(b);
+      exp.set(e);
+    }
+    else
+    {
+      base.set((double)b);
+      exp.set((double)e);
+    }
+    total += Power::apply(base, exp).as_real();
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << (type == INTEGER ? "integer: " : "real:    ") << elapsed.count() * 1000
+            << "ms (total " << total << ")" << std::endl;
+}
+
+int main()
+{
+  time_power(REAL, 12);
+  time_power(INTEGER, 12);
+}
@@ -1,37 +1,169 @@
 // File: ref_env.cpp
 // Purpose: A reference environment class implementation.
-#include <map>
+#include <cstdlib>
+#include <iterator>
+#include <new>
 #include <string>
 #include "parse_tree.h"
 #include "ref_env.h"
 
+// The frame stack: one big block which activations are pushed onto and
+// popped off. Pages are only touched as deep as the calls go.
+static const size_t FRAME_STACK_SIZE = 16 * 1024 * 1024;
+static char *frame_base = nullptr;
+static char *frame_top = nullptr;
+
+// reserve bytes on the frame stack, or return nullptr if it is full
+static void *push_frame(size_t bytes)
+{
+  if (frame_base == nullptr)
+  {
+    frame_base = (char *)std::malloc(FRAME_STACK_SIZE);
+    frame_top = frame_base;
+    if (frame_base == nullptr)
+    {
+      return nullptr;
+    }
+  }
+
+  if (frame_top + bytes > frame_base + FRAME_STACK_SIZE)
+  {
+    return nullptr;
+  }
+  void *frame = frame_top;
+  frame_top += bytes;
+  return frame;
+}
+
+// pop the frame (and any above it)
+static void pop_frame(void *frame)
+{
+  frame_top = (char *)frame;
+}
+
 Ref_Env::Ref_Env() : Ref_Env(nullptr)
 {
   // nothing to do here
 }
 
+// an environment with a scope of its own, filled in as names are set
 Ref_Env::Ref_Env(Ref_Env *_parent) {
+  _refs = 1;
+  _slots = nullptr;
+  _size = 0;
+  _on_stack = false;
+  this->_parent = nullptr;
   parent(_parent);
+  _scope = new Scope(_parent ? _parent->scope() : nullptr);
+  _owns_scope = true;
+}
+
+// an activation of a resolved scope
+Ref_Env::Ref_Env(Ref_Env *_parent, Scope *_scope) {
+  _refs = 1;
+  _slots = nullptr;
+  _size = 0;
+  _on_stack = false;
+  this->_parent = nullptr;
+  parent(_parent);
+  this->_scope = _scope;
+  _owns_scope = false;
+  grow();
+}
+
+// an activation on the frame stack, followed by its slots
+Ref_Env::Ref_Env(Ref_Env *_parent, Scope *_scope, EvalResult *_slots) {
+  _refs = 1;
+  this->_slots = _slots;
+  _size = _scope->size();
+  _on_stack = true;
+  this->_parent = nullptr;
+  parent(_parent);
+  this->_scope = _scope;
+  _owns_scope = false;
+
+  EvalResult undefined;
+  undefined.set_type(UNDEFINED);
+  for(int i = 0; i < _size; i++) {
+    new (&_slots[i]) EvalResult(undefined);
+  }
+}
+
+// a new activation of a function's scope for a call, released on return
+Ref_Env *Ref_Env::activate(Ref_Env *_parent, Scope *_scope)
+{
+  if(not _scope->captured()) {
+    size_t bytes = sizeof(Ref_Env) + _scope->size() * sizeof(EvalResult);
+    void *frame = push_frame(bytes);
+    if(frame != nullptr) {
+      EvalResult *slots = (EvalResult *)((char *)frame + sizeof(Ref_Env));
+      return new (frame) Ref_Env(_parent, _scope, slots);
+    }
+  }
+
+  // captured (or very deep) activations live on the heap
+  return new Ref_Env(_parent, _scope);
+}
+
+Ref_Env::~Ref_Env()
+{
+  // closures in our slots release us as they go, so do this while we exist
+  if(_slots != _heap.data()) {
+    for(int i = 0; i < _size; i++) {
+      _slots[i].~EvalResult();
+    }
+  }
+  _heap.clear();
+  parent(nullptr);
+
+  if(_owns_scope) {
+    delete _scope;
+  }
+}
+
+// drop a reference, deleting the environment with the last one
+void Ref_Env::release()
+{
+  if(--_refs == 0) {
+    if(_on_stack) {
+      this->~Ref_Env();
+      pop_frame(this);
+    } else {
+      delete this;
+    }
+    return;
+  }
+
+  // A function activation whose only remaining references come from
+  // closures in its own slots (a nested fun which never escaped) is an
+  // unreachable cycle: clear the slots to break it.
+  if(not _owns_scope and _refs == captured()) {
+    _refs++;
+    for(int i = 0; i < _size; i++) {
+      _slots[i] = EvalResult();
+    }
+    release();
+  }
 }
 
 // Bind a value to a name
 void Ref_Env::set(const std::string &name, const EvalResult &value)
 {
-  EvalResult *ptr = lookup(name);
+  EvalResult *ptr = find(name);
 
   if(ptr != nullptr) {
     //set the value at the right level
     *ptr = value;
   } else {
     //set the value at the local level
-    _symbol_table[name] = value;
+    slot(_scope->add(name)) = value;
   }
 }
 
 
 void Ref_Env::declare(const std::string &name)
 {
-  _symbol_table[name] = EvalResult();  
+  slot(_scope->add(name)) = EvalResult();
 }
 
 
@@ -54,29 +186,76 @@ EvalResult Ref_Env::get(const std::string &name)
 // Access the parent
 Ref_Env* Ref_Env::parent()
 {
-   return _parent; 
+   return _parent;
 }
 
 
 // Modify the parent
 void Ref_Env::parent(Ref_Env *_parent)
 {
+  if(_parent != nullptr) {
+    _parent->retain();
+  }
+  if(this->_parent != nullptr) {
+    this->_parent->release();
+  }
   this->_parent = _parent;
 }
 
 // Find a name's location
 EvalResult* Ref_Env::lookup(const std::string &name)
 {
-  if(_symbol_table.find(name) != _symbol_table.end()) {
-    // we have found the varaible
-    return &(_symbol_table[name]);
-  }
+  return find(name);
+}
 
-  // check our parent
-  if(parent() != nullptr) {
-    return parent()->lookup(name);
+// The scope this environment is an activation of
+Scope *Ref_Env::scope()
+{
+  return _scope;
+}
+
+// find a name's slot in this environment or its ancestors; resolved names
+// have a slot before they are first assigned, which is passed over
+EvalResult *Ref_Env::find(const std::string &name)
+{
+  for(Ref_Env *env = this; env != nullptr; env = env->parent()) {
+    int i = env->_scope->find(name);
+    if(i >= 0 and env->slot(i).type() != UNDEFINED) {
+      return &env->slot(i);
+    }
   }
 
   // if we make it here, we don't have it
   return nullptr;
-}
\ No newline at end of file
+}
+
+// the references held by closures in our own slots and nowhere else
+int Ref_Env::captured()
+{
+  int count = 0;
+  for(int i = 0; i < _size; i++) {
+    Closure *closure = _slots[i].as_fun();
+    if(closure != nullptr and closure->env == this and closure->refs == 1) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// make room for names added to the scope since we were created
+void Ref_Env::grow()
+{
+  if(_slots != _heap.data()) {
+    // slots on the frame stack cannot grow, so move them to the heap
+    _heap.assign(std::make_move_iterator(_slots), std::make_move_iterator(_slots + _size));
+    for(int i = 0; i < _size; i++) {
+      _slots[i].~EvalResult();
+    }
+  }
+
+  EvalResult undefined;
+  undefined.set_type(UNDEFINED);
+  _heap.resize(_scope->size(), undefined);
+  _slots = _heap.data();
+  _size = (int)_heap.size();
+}
@@ -2,18 +2,32 @@
 // Purpose: A reference environment class definition.
 #ifndef REF_ENV_H
 #define REF_ENV_H
-#include <map>
 #include <string>
+#include <vector>
 #include "parse_tree.h"
+#include "scope.h"
 
-// class prototypes for include compatability
-class EvalResult;
-
-class Ref_Env 
+// A reference environment is an activation of a Scope: a flat array of
+// slots, one per name the scope declares. Resolved variables address the
+// slots directly; the by-name functions remain for dynamic lookups.
+//
+// Environments are reference counted: one reference belongs to whoever
+// created it (a stack variable never gives its up), and one is held by each
+// child environment and by each closure defined in it.
+//
+// Activations of scopes which define no functions cannot be captured, so
+// they die in LIFO order; activate() places those on a contiguous frame
+// stack along with their slots instead of on the heap.
+class Ref_Env
 {
 public:
   Ref_Env();
   Ref_Env(Ref_Env *_parent);
+  Ref_Env(Ref_Env *_parent, Scope *_scope);
+  virtual ~Ref_Env();
+
+  // a new activation of a function's scope for a call, released on return
+  static Ref_Env *activate(Ref_Env *_parent, Scope *_scope);
 
   // Bind a value to a name
   virtual void set(const std::string &name, const EvalResult &value);
@@ -33,9 +47,55 @@ public:
   // Find a name's location
   virtual EvalResult* lookup(const std::string &name);
 
+  // The scope this environment is an activation of
+  Scope *scope();
+
+  // reference counting
+  void retain() { _refs++; }
+  void release();
+
+  // Access a resolved variable
+  EvalResult &at(int depth, int slot)
+  {
+    Ref_Env *env = this;
+    while (depth-- > 0)
+    {
+      env = env->_parent;
+    }
+    return env->slot(slot);
+  }
+
+  // Access a local slot
+  EvalResult &slot(int slot)
+  {
+    if (slot >= _size)
+    {
+      grow();
+    }
+    return _slots[slot];
+  }
+
 private:
-  std::map<std::string, EvalResult> _symbol_table;
+  int _refs;
+  EvalResult *_slots;            // _heap's contents, or the frame stack
+  int _size;
+  std::vector<EvalResult> _heap;
+  bool _on_stack;                // we were placed on the frame stack
+  Scope *_scope;
+  bool _owns_scope;
   Ref_Env *_parent;
+
+  // an activation on the frame stack, followed by its slots
+  Ref_Env(Ref_Env *_parent, Scope *_scope, EvalResult *_slots);
+
+  // find an assigned name's slot in this environment or its ancestors
+  EvalResult *find(const std::string &name);
+
+  // make room for names added to the scope since we were created
+  void grow();
+
+  // the references held by closures in our own slots and nowhere else
+  int captured();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,437 @@
+// File: resolver.cpp
+// Purpose: Lexical scopes and the pass which resolves every variable in the
+//          parse tree to a (depth, slot) pair.
+//
+// Resolution follows the evaluator's assignment rule: a name assigned in a
+// function refers to the nearest enclosing binding which has been assigned
+// when the assignment runs, and is local otherwise. Each scope's bindings
+// are collected (declare) before its uses are resolved (resolve). A name a
+// function assigns which an enclosing scope also binds gets a local slot
+// marked as shadowing; whether the outer binding exists yet is only known
+// at run time, so such variables check their slot as they are used. Names
+// which are never bound anywhere are given global slots so later
+// definitions (e.g. in the REPL) are found.
+#include "scope.h"
+#include "parse_tree.h"
+
+//////////////////////////////////////////
+// Scope
+//////////////////////////////////////////
+Scope::Scope(Scope *_parent)
+{
+  this->_parent = _parent;
+  _captured = false;
+}
+
+// the local slot of a name, or -1
+int Scope::find(const std::string &name) const
+{
+  auto itr = _slots.find(name);
+  if (itr == _slots.end())
+  {
+    return -1;
+  }
+  return itr->second;
+}
+
+// declare a local name, returning its slot
+int Scope::add(const std::string &name)
+{
+  int slot = find(name);
+  if (slot < 0)
+  {
+    slot = (int)_names.size();
+    _slots[name] = slot;
+    _names.push_back(name);
+    _shadows.push_back(false);
+  }
+  return slot;
+}
+
+// bind a name the way assignment does
+void Scope::bind(const std::string &name)
+{
+  int depth, slot;
+  if (not lookup(name, depth, slot))
+  {
+    add(name);
+  }
+  else if (depth > 0)
+  {
+    _shadows[add(name)] = true;
+  }
+}
+
+// true if the slot's name is also bound further out
+bool Scope::shadows(int slot) const
+{
+  return _shadows[slot];
+}
+
+// find a name in this scope or its ancestors, returns false if unbound
+bool Scope::lookup(const std::string &name, int &depth, int &slot) const
+{
+  depth = 0;
+  for (const Scope *scope = this; scope != nullptr; scope = scope->_parent)
+  {
+    slot = scope->find(name);
+    if (slot >= 0)
+    {
+      return true;
+    }
+    depth++;
+  }
+
+  return false;
+}
+
+// the number of slots in the scope
+int Scope::size() const
+{
+  return (int)_names.size();
+}
+
+// the name stored in a slot
+const std::string &Scope::name(int slot) const
+{
+  return _names[slot];
+}
+
+// number of scopes between this one and the global scope
+int Scope::depth() const
+{
+  int depth = 0;
+  for (const Scope *scope = _parent; scope != nullptr; scope = scope->_parent)
+  {
+    depth++;
+  }
+  return depth;
+}
+
+// Access the parent
+Scope *Scope::parent() const
+{
+  return _parent;
+}
+
+// the outermost scope
+Scope *Scope::global()
+{
+  Scope *scope = this;
+  while (scope->_parent != nullptr)
+  {
+    scope = scope->_parent;
+  }
+  return scope;
+}
+
+// note that a fun is defined here, so closures may capture activations
+void Scope::capture()
+{
+  _captured = true;
+}
+
+// true if activations may outlive their call
+bool Scope::captured() const
+{
+  return _captured;
+}
+
+// resolve all of the variables in a program against a scope
+void resolve(Parse_Tree *program, Scope *scope)
+{
+  program->declare(scope);
+  program->resolve(scope);
+}
+
+//////////////////////////////////////////
+// Declarations
+//////////////////////////////////////////
+void Parse_Tree::declare(Scope *scope)
+{
+  // most nodes bind nothing
+}
+
+void Program::declare(Scope *scope)
+{
+  for (auto itr = begin(); itr != end(); itr++)
+  {
+    (*itr)->declare(scope);
+  }
+}
+
+void Branch::declare(Scope *scope)
+{
+  // the body runs in the same environment
+  right()->declare(scope);
+}
+
+void Loop::declare(Scope *scope)
+{
+  // the body runs in the same environment
+  right()->declare(scope);
+}
+
+void Assignment::declare(Scope *scope)
+{
+  Variable *v = dynamic_cast<Variable *>(left());
+  if (v)
+  {
+    scope->bind(v->name());
+  }
+}
+
+void Input::declare(Scope *scope)
+{
+  Variable *v = dynamic_cast<Variable *>(child());
+  if (v)
+  {
+    scope->bind(v->name());
+  }
+}
+
+void Fun_Def::declare(Scope *scope)
+{
+  scope->bind(name());
+}
+
+void Array_Declaration::declare(Scope *scope)
+{
+  scope->bind(std::string(name_.lexeme));
+}
+
+//////////////////////////////////////////
+// Resolution
+//////////////////////////////////////////
+void Parse_Tree::resolve(Scope *scope)
+{
+  // nothing to resolve
+}
+
+void UnaryOp::resolve(Scope *scope)
+{
+  child()->resolve(scope);
+}
+
+void BinaryOp::resolve(Scope *scope)
+{
+  left()->resolve(scope);
+  right()->resolve(scope);
+}
+
+void NaryOp::resolve(Scope *scope)
+{
+  for (auto itr = begin(); itr != end(); itr++)
+  {
+    (*itr)->resolve(scope);
+  }
+}
+
+void Variable::resolve(Scope *scope)
+{
+  if (not scope->lookup(name(), _depth, _slot))
+  {
+    // unbound names live in the global scope
+    _slot = scope->global()->add(name());
+    _depth = scope->depth();
+  }
+
+  // the scope the slot belongs to
+  for (int i = 0; i < _depth; i++)
+  {
+    scope = scope->parent();
+  }
+  _shadows = scope->shadows(_slot);
+}
+
+void Fun_Def::resolve(Scope *scope)
+{
+  var.resolve(scope);
+
+  // escape analysis: the closure made here refers to the enclosing scope's
+  // activation, so it can no longer be discarded when its call returns
+  scope->capture();
+
+  // parameters are always local, and take the first slots
+  _scope = new Scope(scope);
+  Parse_List *params = (Parse_List *)left();
+  for (auto itr = params->begin(); itr != params->end(); itr++)
+  {
+    Variable *param = (Variable *)*itr;
+    _scope->add(param->name());
+    param->resolve(_scope);
+  }
+
+  ::resolve(right(), _scope);
+
+  // now that the body is resolved (and we know whether it defines functions)
+  right()->mark_tail_calls(_scope, std::vector<Parse_Tree *>(), false);
+}
+
+void Array_Declaration::resolve(Scope *scope)
+{
+  if (bound_.tok == ID)
+  {
+    bound_var.resolve(scope);
+  }
+  name_var.resolve(scope);
+}
+
+void Array_Access::resolve(Scope *scope)
+{
+  array_var.resolve(scope);
+  if (index_.tok == ID)
+  {
+    index_var.resolve(scope);
+  }
+}
+
+void Array_Update::resolve(Scope *scope)
+{
+  array_var.resolve(scope);
+  if (index_.tok == ID)
+  {
+    index_var.resolve(scope);
+  }
+  if (update_value_.tok == ID)
+  {
+    value_var.resolve(scope);
+  }
+}
+
+void Array_Size::resolve(Scope *scope)
+{
+  array_var.resolve(scope);
+}
+
+void Load_File::resolve(Scope *scope)
+{
+  file_var.resolve(scope);
+  if (customer_number != "")
+  {
+    customer_var.resolve(scope);
+  }
+}
+
+void Fetch_Record::declare(Scope *scope)
+{
+  if (has_result)
+  {
+    scope->bind(result_var.name());
+  }
+}
+
+void Fetch_Record::resolve(Scope *scope)
+{
+  file_var.resolve(scope);
+  key_var.resolve(scope);
+  if (has_result)
+  {
+    result_var.resolve(scope);
+  }
+}
+
+void Report_Purchases::resolve(Scope *scope)
+{
+  file_var.resolve(scope);
+  if (count_is_var)
+  {
+    count_var.resolve(scope);
+  }
+}
+
+void Write_File::resolve(Scope *scope)
+{
+  file_var.resolve(scope);
+  if (customer_number != "")
+  {
+    customer_var.resolve(scope);
+  }
+  for (Variable &var : vars)
+  {
+    var.resolve(scope);
+  }
+}
+
+//////////////////////////////////////////
+// Tail calls
+//
+// A call is in tail position when nothing but the function's return can
+// follow it. Bodies often end in a run of independent ifs (menu dispatch),
+// so a call may also be followed by if statements whose conditions only
+// read the activation's own locals: a call cannot change those, so the
+// conditions can be checked before the call, and if they are all false it
+// is still a tail call.
+//////////////////////////////////////////
+
+// true if cond can be evaluated early: no effects, and only reads locals of
+// an activation of scope which no closure can reach
+static bool local_condition(Parse_Tree *cond, Scope *scope)
+{
+  if (dynamic_cast<Literal *>(cond) or dynamic_cast<Constant *>(cond))
+  {
+    return true;
+  }
+
+  Variable *var = dynamic_cast<Variable *>(cond);
+  if (var)
+  {
+    return not scope->captured() and var->slot() >= 0 and var->depth() == 0 and
+           not var->shadows();
+  }
+
+  if (dynamic_cast<Equal *>(cond) or dynamic_cast<Not_Equal *>(cond) or
+      dynamic_cast<Less *>(cond) or dynamic_cast<Greater *>(cond) or
+      dynamic_cast<Less_or_Equal *>(cond) or dynamic_cast<Greater_or_Equal *>(cond) or
+      dynamic_cast<Add *>(cond) or dynamic_cast<Subtract *>(cond) or
+      dynamic_cast<Multiply *>(cond))
+  {
+    BinaryOp *op = (BinaryOp *)cond;
+    return local_condition(op->left(), scope) and local_condition(op->right(), scope);
+  }
+
+  if (dynamic_cast<Negation *>(cond) or dynamic_cast<Square *>(cond))
+  {
+    return local_condition(((UnaryOp *)cond)->child(), scope);
+  }
+
+  return false;
+}
+
+void Parse_Tree::mark_tail_calls(Scope *scope, const std::vector<Parse_Tree *> &guards, bool discard)
+{
+  // most statements do more work after any call they make
+}
+
+void Program::mark_tail_calls(Scope *scope, const std::vector<Parse_Tree *> &guards, bool discard)
+{
+  // walk back from the last statement, collecting the trailing ifs
+  std::vector<Parse_Tree *> after = guards;
+  bool last = true;
+  for (auto itr = end(); itr != begin();)
+  {
+    Parse_Tree *statement = *--itr;
+    statement->mark_tail_calls(scope, after, discard or not last);
+
+    Branch *branch = dynamic_cast<Branch *>(statement);
+    if (not branch or not local_condition(branch->left(), scope))
+    {
+      break;
+    }
+    after.insert(after.begin(), branch->left());
+    last = false;
+  }
+}
+
+void Branch::mark_tail_calls(Scope *scope, const std::vector<Parse_Tree *> &guards, bool discard)
+{
+  // an if statement's value is always VOID
+  right()->mark_tail_calls(scope, guards, true);
+}
+
+void Fun_Call::mark_tail_calls(Scope *scope, const std::vector<Parse_Tree *> &guards, bool discard)
+{
+  _tail = true;
+  _guards = guards;
+  _discard = discard;
+}
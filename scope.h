@@ -0,0 +1,69 @@
+// File: scope.h
+// Purpose: Lexical scopes used to resolve variables to (depth, slot) pairs.
+#ifndef SCOPE_H
+#define SCOPE_H
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// class prototype
+class Parse_Tree;
+
+// A scope is the set of names declared by one function body (or by the
+// top level of the program). Every name gets a slot index, which is where
+// an activation of the scope (a Ref_Env) stores the value.
+class Scope
+{
+public:
+  Scope(Scope *_parent);
+
+  // the local slot of a name, or -1
+  int find(const std::string &name) const;
+
+  // declare a local name, returning its slot
+  int add(const std::string &name);
+
+  // bind a name the way assignment does: reuse a local declaration, or
+  // declare it here, shadowing any enclosing one (see shadows)
+  void bind(const std::string &name);
+
+  // true if the slot's name is also bound further out; until the slot is
+  // assigned, the name refers to whichever outer binding has been assigned
+  bool shadows(int slot) const;
+
+  // find a name in this scope or its ancestors, returns false if unbound
+  bool lookup(const std::string &name, int &depth, int &slot) const;
+
+  // the number of slots in the scope
+  int size() const;
+
+  // the name stored in a slot
+  const std::string &name(int slot) const;
+
+  // number of scopes between this one and the global scope
+  int depth() const;
+
+  // Access the parent
+  Scope *parent() const;
+
+  // the outermost scope
+  Scope *global();
+
+  // note that a fun is defined here, so closures may capture activations
+  void capture();
+
+  // true if activations may outlive their call
+  bool captured() const;
+
+private:
+  std::unordered_map<std::string, int> _slots;
+  std::vector<std::string> _names;
+  std::vector<bool> _shadows;
+  Scope *_parent;
+  bool _captured;
+};
+
+// resolve all of the variables in a program against a scope
+void resolve(Parse_Tree *program, Scope *scope);
+
+#endif
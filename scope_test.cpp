@@ -28,10 +28,31 @@ y   1         1        1       1
 z   Undef     12       12      Undef
 q   Undef     7        7       Undef 
 h   Undef     Undef    21      Undef
+
+Resolved programs follow the same rule. In the program below, f's first
+call makes x a local, as there is no global x yet; its second call, after
+the global has been assigned, sets the global.
+
+    before    after
+x   Undef     5
 */
 #include <iostream>
+#include "lexer.h"
+#include "parser.h"
 #include "ref_env.h"
 #include "parse_tree.h"
+#include "scope.h"
+#include "vm.h"
+
+static const char *shadowing =
+  "fun f()\n"
+  "  x = 5\n"
+  "end fun\n"
+  "f()\n"
+  "before = x\n"
+  "x = 2\n"
+  "f()\n"
+  "after = x\n";
 
 void print_result(EvalResult val) {
   if(val.type() == UNDEFINED) {
@@ -41,6 +62,31 @@ void print_result(EvalResult val) {
   }
 }
 
+// run the shadowing program, and print x before and after the global is set
+void print_shadowing(const char *label, bool tree_walk) {
+  Lexer lexer(shadowing);
+  Parser parser(&lexer);
+  Parse_Tree *program = parser.parse();
+  Ref_Env env;
+  resolve(program, env.scope());
+
+  if(tree_walk) {
+    program->eval(&env);
+  } else {
+    Compiler compiler;
+    Chunk *chunk = compiler.compile(program);
+    VM vm;
+    vm.run(chunk, &env);
+    delete chunk;
+  }
+
+  std::cout << label << ": ";
+  print_result(env.get("before"));
+  std::cout << ", ";
+  print_result(env.get("after"));
+  std::cout << std::endl;
+}
+
 int main() {
   Ref_Env ref1; 
   Ref_Env ref2(&ref1); 
@@ -125,4 +171,7 @@ int main() {
   std::cout << ", ";
   print_result(ref4.get("h")); 
   std::cout << std::endl;
-}
\ No newline at end of file
+
+  print_shadowing("x (tree)", true);
+  print_shadowing("x (vm)", false);
+}
@@ -0,0 +1,106 @@
+// File: top_items.cpp
+// Purpose: Implementation of the fixed size table of top items.
+#include "top_items.h"
+#include <algorithm>
+
+Top_Items::Top_Items(size_t slots) : _slots(slots < 1 ? 1 : slots), _exact(true)
+{
+}
+
+void Top_Items::add(const Purchase &purchase)
+{
+  std::string name(purchase.itemName);
+  auto found = _numbers.find(name);
+  size_t item;
+  if (found != _numbers.end())
+  {
+    item = found->second;
+  }
+  else if (_items.size() < _slots)
+  {
+    item = _items.size();
+    _items.push_back(Item{name, Purchase_Totals(), Decimal()});
+    _position.push_back(_heap.size());
+    _heap.push_back(item);
+    _numbers[name] = item;
+  }
+  else
+  {
+    // take over the counter with the least revenue
+    item = _heap[0];
+    _numbers.erase(_items[item].name);
+    _items[item].name = name;
+    _items[item].error = _items[item].totals.revenue;
+    _numbers[name] = item;
+    _exact = false;
+  }
+
+  // a refund lowers the revenue, so the item may move either way
+  _items[item].totals.add(purchase);
+  sift_up(_position[item]);
+  sift_down(_position[item]);
+}
+
+// the n items with the most revenue, most first
+void Top_Items::top(size_t n, std::vector<Item> &result) const
+{
+  result = _items;
+  std::sort(result.begin(), result.end(), [](const Item &a, const Item &b) {
+    int order = Decimal::compare(a.totals.revenue, b.totals.revenue);
+    return order != 0 ? order > 0 : a.name < b.name;
+  });
+  if (result.size() > n)
+  {
+    result.resize(n);
+  }
+}
+
+// true if no counter has been taken over
+bool Top_Items::exact() const
+{
+  return _exact;
+}
+
+void Top_Items::sift_up(size_t i)
+{
+  while (i > 0 and less(i, (i - 1) / 2))
+  {
+    swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+void Top_Items::sift_down(size_t i)
+{
+  for (;;)
+  {
+    size_t least = i, left = 2 * i + 1, right = left + 1;
+    if (left < _heap.size() and less(left, least))
+    {
+      least = left;
+    }
+    if (right < _heap.size() and less(right, least))
+    {
+      least = right;
+    }
+    if (least == i)
+    {
+      return;
+    }
+    swap(i, least);
+    i = least;
+  }
+}
+
+// true if the item at heap position a has less revenue than the one at b
+bool Top_Items::less(size_t a, size_t b) const
+{
+  return Decimal::compare(_items[_heap[a]].totals.revenue, _items[_heap[b]].totals.revenue) < 0;
+}
+
+void Top_Items::swap(size_t i, size_t j)
+{
+  std::swap(_heap[i], _heap[j]);
+  _position[_heap[i]] = i;
+  _position[_heap[j]] = j;
+}
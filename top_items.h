@@ -0,0 +1,53 @@
+// File: top_items.h
+// Purpose: The items with the most revenue in a stream of purchases, kept
+//          in a fixed amount of memory.
+#ifndef TOP_ITEMS_H
+#define TOP_ITEMS_H
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "company_db.h"
+
+// Totals purchases by item with a fixed number of counters (the "space
+// saving" algorithm). An item without a counter takes over the one with the
+// least revenue, and keeps its totals, so an item's totals are upper bounds
+// and its revenue is over by at most its error. Every item with more than
+// 1/slots of the revenue is sure to have a counter, and the totals are
+// exact as long as there are no more items than counters.
+class Top_Items
+{
+public:
+  struct Item
+  {
+    std::string name;
+    Purchase_Totals totals;
+    Decimal error;  // the revenue it inherited with its counter
+  };
+
+  Top_Items(size_t slots);
+
+  void add(const Purchase &purchase);
+
+  // the n items with the most revenue, most first
+  void top(size_t n, std::vector<Item> &result) const;
+
+  // true if no counter has been taken over
+  bool exact() const;
+
+private:
+  size_t _slots;
+  std::vector<Item> _items;
+  std::vector<size_t> _heap;      // numbers of the items, least revenue first
+  std::vector<size_t> _position;  // where each item is in the heap
+  std::unordered_map<std::string, size_t> _numbers;
+  bool _exact;
+
+  // move the item at heap position i until the heap is in order again
+  void sift_up(size_t i);
+  void sift_down(size_t i);
+
+  bool less(size_t a, size_t b) const;
+  void swap(size_t i, size_t j);
+};
+
+#endif
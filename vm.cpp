@@ -0,0 +1,205 @@
+// File: vm.cpp
+// Purpose: Implementation of the bytecode stack machine.
+#include "vm.h"
+#include <iostream>
+
+// run a compiled program in the given environment
+EvalResult VM::run(Chunk *chunk, Ref_Env *env)
+{
+  _frames.push_back({chunk, 0, env, EvalResult(), false});
+
+  for (;;)
+  {
+    Frame &frame = _frames.back();
+    Instruction ins = frame.chunk->code[frame.ip++];
+
+    switch (ins.op)
+    {
+    case OP_CONST:
+      _stack.push_back(frame.chunk->constants[ins.arg]);
+      break;
+
+    case OP_VOID:
+      _stack.push_back(EvalResult());
+      break;
+
+    case OP_LOAD:
+      _stack.push_back(frame.env->at(ins.depth, ins.arg));
+      break;
+
+    case OP_STORE:
+      frame.env->at(ins.depth, ins.arg) = std::move(_stack.back());
+      _stack.pop_back();
+      break;
+
+    case OP_POP:
+      _stack.pop_back();
+      break;
+
+    case OP_RESULT:
+      frame.result = std::move(_stack.back());
+      _stack.pop_back();
+      break;
+
+    case OP_CLEAR:
+      frame.result = EvalResult();
+      break;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_POW:
+    case OP_EQ:
+    case OP_NE:
+    case OP_LT:
+    case OP_GT:
+    case OP_LTE:
+    case OP_GTE:
+    {
+      // operate in place on the top two entries
+      EvalResult &r = _stack.back();
+      EvalResult &l = _stack[_stack.size() - 2];
+      switch (ins.op)
+      {
+      case OP_ADD: l = Add::apply(l, r); break;
+      case OP_SUB: l = Subtract::apply(l, r); break;
+      case OP_MUL: l = Multiply::apply(l, r); break;
+      case OP_DIV: l = Divide::apply(l, r); break;
+      case OP_MOD: l = Mod::apply(l, r); break;
+      case OP_POW: l = Power::apply(l, r); break;
+      case OP_EQ: l = Equal::apply(l, r); break;
+      case OP_NE: l = Not_Equal::apply(l, r); break;
+      case OP_LT: l = Less::apply(l, r); break;
+      case OP_GT: l = Greater::apply(l, r); break;
+      case OP_LTE: l = Less_or_Equal::apply(l, r); break;
+      default: l = Greater_or_Equal::apply(l, r); break;
+      }
+      _stack.pop_back();
+      break;
+    }
+
+    case OP_NEG:
+      _stack.back() = Negation::apply(_stack.back());
+      break;
+
+    case OP_SQUARE:
+      _stack.back() = Square::apply(_stack.back());
+      break;
+
+    case OP_JUMP:
+      frame.ip = ins.arg;
+      break;
+
+    case OP_JUMP_IF_FALSE:
+      if (not _stack.back().as_bool())
+      {
+        frame.ip = ins.arg;
+      }
+      _stack.pop_back();
+      break;
+
+    case OP_CLOSURE:
+    {
+      Chunk *fun = frame.chunk->functions[ins.arg];
+      Closure *closure = new Closure(fun->def, frame.env);
+      closure->code = fun;
+      EvalResult result;
+      result.set(closure);
+      _stack.push_back(result);
+      break;
+    }
+
+    case OP_CALL:
+      call(ins.arg);
+      break;
+
+    case OP_TAIL_CALL:
+      call(ins.arg, true, ins.depth);
+      break;
+
+    case OP_RETURN:
+    {
+      EvalResult result = frame.discard ? EvalResult() : std::move(frame.result);
+      Ref_Env *local = frame.env;
+      _frames.pop_back();
+      if (_frames.empty())
+      {
+        return result;
+      }
+
+      // the local scope lives on only if a closure captured it
+      local->release();
+      _stack.push_back(std::move(result));
+      break;
+    }
+
+    case OP_DISPLAY:
+      Display::show(_stack.back());
+      _stack.back() = EvalResult();
+      break;
+
+    case OP_EVAL:
+      _stack.push_back(frame.chunk->nodes[ins.arg]->eval(frame.env));
+      break;
+    }
+  }
+}
+
+// enter the function on the stack below argc arguments, in place of the
+// current frame for a tail call
+void VM::call(int argc, bool tail, bool discard)
+{
+  size_t base = _stack.size() - argc;
+  EvalResult fr = _stack[base - 1];
+
+  // if we don't have a function, return an error
+  if (fr.type() != FUNCTION)
+  {
+    std::cerr << "Error: Attempted to call a non-function" << std::endl;
+    _stack.resize(base - 1);
+    _stack.push_back(EvalResult());
+    return;
+  }
+
+  // Check parameter binding
+  Closure *closure = fr.as_fun();
+  Chunk *fun = closure->code;
+  if (fun->arity != argc)
+  {
+    std::cerr << "Error: Incorrect number of arguments" << std::endl;
+    _stack.resize(base - 1);
+    _stack.push_back(EvalResult());
+    return;
+  }
+
+  if (tail)
+  {
+    // the caller is done with its activation, so release it first and
+    // the callee's can take its place on the frame stack
+    _frames.back().env->release();
+  }
+
+  // Create a local scope and bind the arguments to the first slots
+  Ref_Env *local = Ref_Env::activate(closure->env, closure->fun->scope());
+  for (int i = 0; i < argc; i++)
+  {
+    local->slot(i) = std::move(_stack[base + i]);
+  }
+  _stack.resize(base - 1);
+
+  if (tail)
+  {
+    Frame &frame = _frames.back();
+    frame.chunk = fun;
+    frame.ip = 0;
+    frame.env = local;
+    frame.result = EvalResult();
+    frame.discard = frame.discard or discard;
+  }
+  else
+  {
+    _frames.push_back({fun, 0, local, EvalResult(), false});
+  }
+}
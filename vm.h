@@ -0,0 +1,123 @@
+// File: vm.h
+// Purpose: Bytecode definitions, the compiler which lowers a parse tree into
+//          bytecode, and the stack machine which runs it.
+#ifndef VM_H
+#define VM_H
+#include <string>
+#include <vector>
+#include "parse_tree.h"
+#include "ref_env.h"
+
+// our bytecode instructions
+enum Opcode : unsigned char
+{
+  OP_CONST,         // push constants[arg]
+  OP_VOID,          // push a VOID result
+  OP_LOAD,          // push the variable at (depth, arg)
+  OP_STORE,         // pop into the variable at (depth, arg)
+  OP_POP,           // discard the top of the stack
+  OP_RESULT,        // pop into the frame's result register
+  OP_CLEAR,         // set the frame's result register to VOID
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_POW,
+  OP_NEG,
+  OP_SQUARE,
+  OP_EQ,
+  OP_NE,
+  OP_LT,
+  OP_GT,
+  OP_LTE,
+  OP_GTE,
+  OP_JUMP,          // continue at arg
+  OP_JUMP_IF_FALSE, // pop, continue at arg when the value is false
+  OP_CLOSURE,       // push a closure of functions[arg] over the environment
+  OP_CALL,          // call the function below arg arguments
+  OP_TAIL_CALL,     // OP_CALL, replacing the current frame (depth 1: and
+                    // return VOID from it rather than the callee's value)
+  OP_RETURN,        // return the frame's result register
+  OP_DISPLAY,       // pop and print, push VOID
+  OP_EVAL           // push nodes[arg]->eval(env)
+};
+
+// a single instruction
+struct Instruction
+{
+  Opcode op;
+  unsigned short depth; // scopes to walk out for OP_LOAD/OP_STORE
+  int arg;
+};
+
+// A compiled body of code (the program or a function)
+class Chunk
+{
+public:
+  Chunk(Fun_Def *def);
+  ~Chunk();
+
+  Fun_Def *def;                     // nullptr for the top level program
+  int arity;                        // number of parameters
+  std::vector<Instruction> code;    // the instructions
+  std::vector<EvalResult> constants;
+  std::vector<Parse_Tree *> nodes;  // nodes left to the tree walker
+  std::vector<Chunk *> functions;   // nested function bodies
+};
+
+// Lowers a parse tree into a chunk. Nodes emit their own code through
+// their compile() method, using the helpers below.
+class Compiler
+{
+public:
+  // compile a top level program (which must already be resolved)
+  Chunk *compile(Parse_Tree *program);
+
+  // emit an instruction, returning its address
+  int emit(Opcode op, int arg = 0, int depth = 0);
+
+  // the address of the next instruction
+  int here();
+
+  // point the jump at address at to the next instruction
+  void patch(int at);
+
+  // store the value of a statement in the result register
+  void result();
+
+  // add to the chunk's tables, returning the index
+  int constant(EvalResult value);
+  int node(Parse_Tree *node);
+  int function(Fun_Def *def);
+
+private:
+  Chunk *_chunk;
+};
+
+// The stack machine
+class VM
+{
+public:
+  // run a compiled program in the given environment
+  EvalResult run(Chunk *chunk, Ref_Env *env);
+
+private:
+  struct Frame
+  {
+    Chunk *chunk;
+    int ip;
+    Ref_Env *env;
+    EvalResult result;
+    bool discard;     // return VOID (a tail call replaced an if's body)
+  };
+
+  std::vector<EvalResult> _stack;
+  std::vector<Frame> _frames;
+
+  // enter the function on the stack below argc arguments, in place of the
+  // current frame for a tail call
+  void call(int argc, bool tail = false, bool discard = false);
+};
+
+#endif